@@ -21,11 +21,23 @@
 // SOFTWARE.
 
 #include "platform.h"
+#include "audio.h"
 #include "debug.h"
+#include "debugger.h"
+#include "compat.h"
+#ifdef CHIP8_HAVE_SOUNDIO
+#include "device_sink.h"
+#endif
+#include "instruction_log.h"
+#include "recorder.h"
+#include "rom.h"
+#include "telemetry.h"
 
 #include <iostream>
+#include <memory>
 #include <string>
 #include <cctype>
+#include <cstdlib>
 #include <algorithm>
 
 namespace std {
@@ -41,28 +53,174 @@ static int parse_command_line(int argc, char **argv);
 
 struct
 {
-    bool runSanityTest = false;
+    bool debugger = false;
+    std::string traceFile;
+    std::string romFile;
+    std::string recordPath;
+    std::string screenshotFile;
+    std::string audioOutput; // null, device or a .wav path, empty picks by backend
+    platform::backend backend = platform::backend::glfw;
+    uint64_t frames = 0; // 0 runs until the window closes
+    compat::options compat;
 } s_config;
 
 int main(int argc, char **argv)
 {
     int cmdLine = parse_command_line(argc - 1, &argv[1]);
+    if (cmdLine != 0)
+    {
+        return cmdLine;
+    }
 
-    platform::display display;
+    // live counters for chip8_top, the emulator runs on without them
+    debug::telemetry::instance().open();
 
-    if (s_config.runSanityTest)
+    if (s_config.compat.directory.empty() == false)
     {
-        std::cout << "Begin Sanity Test\n";
-        debug::test_sanity();
-        std::cout << "Sanity Test Complete.\n";
+        // headless ROM compatibility suite, no window
+        return compat::run_suite(s_config.compat) ? 1 : cmdLine;
     }
-    else
+
+    std::unique_ptr<platform::display> display = platform::create_display(s_config.backend);
+    if (display->initialize() == false && s_config.backend == platform::backend::glfw)
     {
-        display.initialize();
+        // no display server, keep running headless
+        std::cout << "Unable to open a window, using the offscreen backend" << std::endl;
+        s_config.backend = platform::backend::offscreen;
+        display = platform::create_display(s_config.backend);
+        display->initialize();
+    }
+
+    debug::instruction_log traceLog;
+    platform::recorder recorder;
+    mpu::hardware_hooks hooks;
+    hooks.pDisplay = display.get();
 
-        while (display.ui_close() == false)
+    debug::debugger debugger;
+    if (s_config.debugger)
+    {
+        hooks.pDebug = &debugger;
+    }
+
+    if (s_config.recordPath.empty() == false)
+    {
+        if (recorder.open(s_config.recordPath, display.get()))
+        {
+            hooks.pDisplay = &recorder;
+        }
+        else
         {
-            display.update();
+            std::cout << "Unable to record to \"" << s_config.recordPath << "\"" << std::endl;
+        }
+    }
+
+    // the generator outlives its sink, which is declared (and destroyed) after it
+    std::string audioOutput = s_config.audioOutput;
+    if (audioOutput.empty() && s_config.backend == platform::backend::glfw)
+    {
+        audioOutput = "device";
+    }
+
+    std::unique_ptr<audio::generator> tone;
+    std::unique_ptr<audio::sink> speaker;
+    if (audioOutput == "null")
+    {
+        // no generator either, samples nobody takes are not worth synthesizing
+    }
+    else if (audioOutput == "device")
+    {
+#ifdef CHIP8_HAVE_SOUNDIO
+        speaker.reset(new audio::device_sink());
+#else
+        if (s_config.audioOutput.empty() == false)
+        {
+            std::cout << "Built without audio device support" << std::endl;
+        }
+#endif
+    }
+    else if (audioOutput.empty() == false)
+    {
+        speaker.reset(new audio::wav_sink(audioOutput));
+    }
+
+    if (speaker)
+    {
+        tone.reset(new audio::generator(audio::default_sample_rate,
+                                        audioOutput == "device" ? audio::realtime_capacity : audio::offline_capacity));
+        if (speaker->open(*tone))
+        {
+            hooks.pAudio = tone.get();
+        }
+        else
+        {
+            std::cout << "Unable to open audio output \"" << audioOutput << "\"" << std::endl;
+        }
+    }
+
+    if (s_config.traceFile.empty() == false)
+    {
+        if (traceLog.open(s_config.traceFile))
+        {
+            hooks.pTrace = &traceLog;
+        }
+        else
+        {
+            std::cout << "Unable to open trace file \"" << s_config.traceFile << "\"" << std::endl;
+        }
+    }
+
+    mpu::chip8 cpu(hooks);
+
+    if (s_config.romFile.empty() == false)
+    {
+        rom::image_ptr image = rom::cache::instance().load(s_config.romFile);
+        if (image == nullptr)
+        {
+            std::cout << "Unable to load ROM \"" << s_config.romFile << "\"" << std::endl;
+            return 1;
+        }
+        image->boot(cpu);
+    }
+
+    debug::telemetry_slot &slot = debug::telemetry::instance().claim(
+        s_config.romFile.empty() ? std::string("chip8") : s_config.romFile);
+
+    bool running = s_config.debugger == false || debugger.prompt(cpu, std::cin, std::cout);
+    while (running && display->ui_close() == false &&
+           (s_config.frames == 0 || cpu.get_frames() < s_config.frames))
+    {
+        if (cpu.frame(mpu::chip8::default_frame_instructions) == false)
+        {
+            // stopped on a breakpoint or watchpoint, the frame finishes on the next call
+            running = debugger.prompt(cpu, std::cin, std::cout);
+            continue;
+        }
+
+        uint64_t const presentStart = debug::telemetry::now();
+        display->update();
+        uint64_t const presentEnd = debug::telemetry::now();
+
+        slot.publish(cpu, presentEnd);
+        slot.record_update(presentEnd - presentStart);
+    }
+
+    slot.set_status(debug::telemetry_slot::idle);
+    debug::telemetry::instance().release(slot);
+
+    if (speaker)
+    {
+        speaker->close();
+    }
+
+    if (s_config.screenshotFile.empty() == false)
+    {
+        if (s_config.backend == platform::backend::offscreen)
+        {
+            static_cast<platform::offscreen_display&>(*display).screenshot(s_config.screenshotFile);
+        }
+        else
+        {
+            std::cout << "Screenshots need the offscreen backend" << std::endl;
         }
     }
 
@@ -88,10 +246,92 @@ static int parse_command_line(int argc, char **argv)
         else if (opt == "s" ||
                  opt == "-s" ||
                  opt == "-S" ||
-                 std::toupper(opt) == "-SANITY")
+                 std::toupper(opt) == "-SUITE")
         {
-            debug::enable();
-            s_config.runSanityTest = true;
+            // -s <rom directory> runs the compatibility suite
+            if (i + 1 < argc)
+            {
+                s_config.compat.directory = argv[++i];
+            }
+            else
+            {
+                std::cout << "-s needs a ROM directory" << std::endl;
+                return 1;
+            }
+        }
+        else if (opt == "u" ||
+                 opt == "-u" ||
+                 opt == "-U" ||
+                 std::toupper(opt) == "-UPDATE")
+        {
+            // rewrite golden hashes instead of comparing against them
+            s_config.compat.update = true;
+        }
+        else if ((opt == "t" ||
+                  opt == "-t" ||
+                  opt == "-T" ||
+                  std::toupper(opt) == "-TRACE") && i + 1 < argc)
+        {
+            // record every executed instruction to a binary log
+            s_config.traceFile = argv[++i];
+        }
+        else if ((opt == "r" ||
+                  opt == "-r" ||
+                  opt == "-R" ||
+                  std::toupper(opt) == "-RECORD") && i + 1 < argc)
+        {
+            // capture frames to <path>.y4m or a <path>_NNNNNNNN.png sequence,
+            // in compat mode a directory receiving one .y4m per ROM
+            s_config.recordPath = argv[++i];
+            s_config.compat.record = s_config.recordPath;
+        }
+        else if ((opt == "b" ||
+                  opt == "-b" ||
+                  opt == "-B" ||
+                  std::toupper(opt) == "-BACKEND") && i + 1 < argc)
+        {
+            // display backend: null, offscreen or glfw
+            std::string name(argv[++i]);
+            if (platform::parse_backend(name, s_config.backend) == false)
+            {
+                std::cout << "Unknown display backend: \"" << name << "\"" << std::endl;
+            }
+        }
+        else if ((opt == "f" ||
+                  opt == "-f" ||
+                  opt == "-F" ||
+                  std::toupper(opt) == "-FRAMES") && i + 1 < argc)
+        {
+            // stop after N frames, for headless runs
+            s_config.frames = strtoull(argv[++i], nullptr, 10);
+        }
+        else if ((opt == "p" ||
+                  opt == "-p" ||
+                  opt == "-P" ||
+                  std::toupper(opt) == "-SCREENSHOT") && i + 1 < argc)
+        {
+            // save the last offscreen frame as a png on exit
+            s_config.screenshotFile = argv[++i];
+        }
+        else if ((opt == "a" ||
+                  opt == "-a" ||
+                  opt == "-A" ||
+                  std::toupper(opt) == "-AUDIO") && i + 1 < argc)
+        {
+            // sound output: null, device or a .wav file, default device with a window
+            s_config.audioOutput = argv[++i];
+        }
+        else if (opt == "g" ||
+                 opt == "-g" ||
+                 opt == "-G" ||
+                 std::toupper(opt) == "-DEBUGGER")
+        {
+            // start stopped at the debugger prompt
+            s_config.debugger = true;
+        }
+        else if (opt[0] != '-' && s_config.romFile.empty())
+        {
+            s_config.romFile = argv[i];
         }
         else
         {
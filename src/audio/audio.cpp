@@ -0,0 +1,191 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "audio.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const uint32_t frames_per_second = 60;
+    const uint64_t pattern_bits      = mpu::audio_state::pattern_size * 8;
+    const uint64_t phase_mask        = (pattern_bits << 32) - 1;
+
+    uint32_t round_up_pow2(uint32_t value)
+    {
+        uint32_t result = 1;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+}
+
+audio::sample_ring::sample_ring(uint32_t capacity) :
+    samples(round_up_pow2(capacity)),
+    mask(round_up_pow2(capacity) - 1),
+    head(0),
+    tail(0),
+    gapHead(0),
+    gapTail(0),
+    pending(0)
+{
+}
+
+uint32_t audio::sample_ring::space(void) const
+{
+    if (pending)
+    {
+        // samples pushed now would land before the unrecorded gap
+        return 0;
+    }
+    return capacity() - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+}
+
+void audio::sample_ring::drop(uint32_t count)
+{
+    pending += count;
+    record_gap();
+}
+
+bool audio::sample_ring::record_gap(void)
+{
+    uint32_t const at = gapHead.load(std::memory_order_relaxed);
+    if (at - gapTail.load(std::memory_order_acquire) == max_gaps)
+    {
+        return false; // the consumer is behind, keep adding to pending
+    }
+
+    gaps[at % max_gaps].at    = head.load(std::memory_order_relaxed);
+    gaps[at % max_gaps].count = pending;
+    gapHead.store(at + 1, std::memory_order_release);
+    pending = 0;
+    return true;
+}
+
+void audio::sample_ring::push(int16_t const *data, uint32_t count)
+{
+    uint32_t const start = head.load(std::memory_order_relaxed);
+    uint32_t const first = std::min(count, capacity() - (start & mask));
+    memcpy(&samples[start & mask], data, first * sizeof(int16_t));
+    memcpy(&samples[0], data + first, (count - first) * sizeof(int16_t));
+    head.store(start + count, std::memory_order_release);
+}
+
+uint32_t audio::sample_ring::available(void) const
+{
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+}
+
+uint32_t audio::sample_ring::pop(int16_t *data, uint32_t count)
+{
+    count = std::min(count, available());
+    uint32_t const start = tail.load(std::memory_order_relaxed);
+    uint32_t const first = std::min(count, capacity() - (start & mask));
+    memcpy(data, &samples[start & mask], first * sizeof(int16_t));
+    memcpy(data + first, &samples[0], (count - first) * sizeof(int16_t));
+    tail.store(start + count, std::memory_order_release);
+    return count;
+}
+
+uint32_t audio::sample_ring::discard(uint32_t count)
+{
+    count = std::min(count, available());
+    tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    return count;
+}
+
+bool audio::sample_ring::peek_gap(uint32_t &before, uint32_t &count) const
+{
+    uint32_t const at = gapTail.load(std::memory_order_relaxed);
+    if (at == gapHead.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    before = gaps[at % max_gaps].at - tail.load(std::memory_order_relaxed);
+    count  = gaps[at % max_gaps].count;
+    return true;
+}
+
+void audio::sample_ring::pop_gap(void)
+{
+    gapTail.store(gapTail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void audio::sample_ring::skip_gaps(void)
+{
+    gapTail.store(gapHead.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+audio::generator::generator(uint32_t rate, uint32_t capacity) :
+    sampleRate(rate),
+    samples(capacity),
+    remainder(0),
+    phase(0),
+    pitch(0),
+    step(0),
+    produced(0),
+    buffer(rate / frames_per_second + 1)
+{
+}
+
+void audio::generator::frame(bool active, mpu::audio_state const& audio)
+{
+    uint32_t const total = sampleRate + remainder;
+    uint32_t const count = total / frames_per_second;
+    remainder = total % frames_per_second;
+    produced += count;
+
+    if (step == 0 || audio.pitch != pitch)
+    {
+        // 4000 * 2^((pitch - 64) / 48) pattern bits per second
+        pitch = audio.pitch;
+        step = static_cast<uint64_t>(4000.0 * std::pow(2.0, (pitch - 64.0) / 48.0) / sampleRate * 4294967296.0);
+    }
+
+    if (samples.space() < count)
+    {
+        // sink is behind, keep time moving without synthesizing
+        samples.drop(count);
+        phase = (phase + step * count) & phase_mask;
+        return;
+    }
+
+    if (active)
+    {
+        for (uint32_t n = 0; n < count; ++n)
+        {
+            uint32_t const bit = static_cast<uint32_t>(phase >> 32);
+            buffer[n] = ((audio.pattern[bit >> 3] >> (7 - (bit & 7))) & 1) ? default_amplitude : -default_amplitude;
+            phase = (phase + step) & phase_mask;
+        }
+    }
+    else
+    {
+        memset(buffer.data(), 0, count * sizeof(int16_t));
+        phase = (phase + step * count) & phase_mask;
+    }
+
+    samples.push(buffer.data(), count);
+}
@@ -0,0 +1,154 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __AUDIO_H__
+#define __AUDIO_H__
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip8.h"
+
+namespace audio
+{
+    const static uint32_t default_sample_rate = 44100;
+    const static uint32_t realtime_capacity   = 1u << 13; // ~190ms at 44.1kHz, bounds latency after fast-forward
+    const static uint32_t offline_capacity    = 1u << 18; // ~6s, lets file writers fall behind without gaps
+    const static int16_t  default_amplitude   = 8000;
+
+    // lock-free single producer (emulation thread), single consumer (sink)
+    // ring of mono 16 bit samples. Samples the producer could not queue are
+    // recorded as gaps at the position they were dropped from.
+    class sample_ring
+    {
+        public:
+            const static uint32_t max_gaps = 64;
+
+            // capacity is rounded up to a power of 2
+            explicit sample_ring(uint32_t capacity = realtime_capacity);
+
+            uint32_t capacity(void) const { return mask + 1; }
+
+            // producer side
+            uint32_t space(void) const; // 0 while a drop could not be recorded yet
+            void push(int16_t const *samples, uint32_t count); // count <= space()
+            void drop(uint32_t count);
+
+            // consumer side
+            uint32_t available(void) const;
+            uint32_t pop(int16_t *samples, uint32_t count);
+            uint32_t discard(uint32_t count);
+            // oldest gap, before = samples to pop until it is reached. Read
+            // available() first, gaps within it are always visible
+            bool peek_gap(uint32_t &before, uint32_t &count) const;
+            void pop_gap(void);
+            void skip_gaps(void);
+
+        private:
+            struct gap
+            {
+                uint32_t at;    // head when the samples were dropped
+                uint32_t count;
+            };
+
+            std::vector<int16_t>  samples;
+            uint32_t              mask;
+            std::atomic<uint32_t> head; // written by producer
+            uint8_t               padHead[64 - sizeof(std::atomic<uint32_t>)];
+            std::atomic<uint32_t> tail; // written by consumer
+            uint8_t               padTail[64 - sizeof(std::atomic<uint32_t>)];
+            gap                   gaps[max_gaps];
+            std::atomic<uint32_t> gapHead; // written by producer
+            std::atomic<uint32_t> gapTail; // written by consumer
+            uint32_t              pending; // dropped at head, waiting for a free gap entry
+
+            bool record_gap(void);
+    };
+
+    // turns the per-frame sound timer state into samples in emulated time,
+    // exactly rate / 60 samples per frame on average. Never blocks: a frame
+    // that does not fit into the ring is dropped and counted instead.
+    class generator : public mpu::audio_hook
+    {
+        public:
+            explicit generator(uint32_t rate = default_sample_rate, uint32_t capacity = realtime_capacity);
+
+            uint32_t rate(void) const       { return sampleRate; }
+            sample_ring& ring(void)         { return samples; }
+            uint64_t get_samples(void) const { return produced; }
+
+            virtual void frame(bool active, mpu::audio_state const& audio);
+
+        private:
+            uint32_t             sampleRate;
+            sample_ring          samples;
+            uint32_t             remainder; // sample fraction carried between frames, in 1/60ths
+            uint64_t             phase;     // pattern position, 32.32 fixed point bits
+            uint8_t              pitch;
+            uint64_t             step;      // phase advance per sample at pitch
+            uint64_t             produced;
+            std::vector<int16_t> buffer;
+    };
+
+    // consumes a generator's samples on its own schedule
+    class sink
+    {
+        public:
+            virtual ~sink() {}
+
+            virtual bool open(generator &source) = 0;
+            virtual void close(void) = 0;
+    };
+
+    // 16 bit mono PCM .wav, written by a background thread. Dropped samples
+    // are written as silence where they were dropped, so the file keeps the
+    // emulated timeline.
+    class wav_sink : public sink
+    {
+        public:
+            explicit wav_sink(std::string const &path);
+            virtual ~wav_sink();
+
+            virtual bool open(generator &source);
+            virtual void close(void);
+
+            uint64_t size(void) const { return written; }
+
+        private:
+            std::string       path;
+            FILE             *file;
+            generator        *source;
+            std::thread       thread;
+            std::atomic<bool> stop;
+            uint64_t          written; // samples
+            uint64_t          gaps;    // samples written as silence
+
+            void run(void);
+            uint32_t drain(std::vector<int16_t> &buffer);
+            void write_header(void);
+    };
+}
+
+#endif//__AUDIO_H__
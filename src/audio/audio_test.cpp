@@ -0,0 +1,233 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// audio_test: sample ring wraparound and gaps, generator sample accounting
+// and the .wav writer, run by ctest
+
+#include "audio.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    int s_failures = 0;
+
+    #define CHECK(expr)                                                          \
+        do                                                                       \
+        {                                                                        \
+            if (!(expr))                                                         \
+            {                                                                    \
+                printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);  \
+                ++s_failures;                                                    \
+            }                                                                    \
+        } while (0)
+
+    mpu::audio_state tone(void)
+    {
+        mpu::audio_state audio;
+        memset(audio.pattern, 0xFF, sizeof(audio.pattern));
+        audio.pitch = mpu::audio_state::default_pitch;
+        return audio;
+    }
+
+    uint32_t get32(uint8_t const *in)
+    {
+        return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+    }
+
+    void test_ring_wraparound(void)
+    {
+        audio::sample_ring ring(6);
+        CHECK(ring.capacity() == 8);
+        CHECK(ring.space() == 8);
+
+        int16_t in[8];
+        int16_t out[8];
+        for (int round = 0; round < 5; ++round)
+        {
+            // 5 per round walks the start across the end of the buffer
+            for (int n = 0; n < 5; ++n)
+            {
+                in[n] = static_cast<int16_t>(round * 10 + n);
+            }
+            ring.push(in, 5);
+            CHECK(ring.available() == 5);
+            CHECK(ring.space() == 3);
+
+            memset(out, 0, sizeof(out));
+            CHECK(ring.pop(out, 8) == 5);
+            CHECK(memcmp(in, out, 5 * sizeof(int16_t)) == 0);
+            CHECK(ring.available() == 0);
+        }
+
+        ring.push(in, 4);
+        CHECK(ring.discard(10) == 4);
+        CHECK(ring.space() == 8);
+    }
+
+    void test_ring_gaps(void)
+    {
+        audio::sample_ring ring(8);
+        int16_t samples[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+        uint32_t before = 0;
+        uint32_t count = 0;
+
+        CHECK(ring.peek_gap(before, count) == false);
+
+        ring.push(samples, 3);
+        ring.drop(4);
+        ring.push(samples, 2);
+        CHECK(ring.peek_gap(before, count));
+        CHECK(before == 3 && count == 4);
+
+        int16_t out[8];
+        CHECK(ring.pop(out, 2) == 2);
+        CHECK(ring.peek_gap(before, count));
+        CHECK(before == 1 && count == 4);
+        ring.pop_gap();
+        CHECK(ring.peek_gap(before, count) == false);
+        ring.discard(ring.available());
+
+        // once every entry is taken drops collect until one frees up, and
+        // nothing may be pushed past them meanwhile
+        for (uint32_t n = 0; n < audio::sample_ring::max_gaps; ++n)
+        {
+            ring.drop(1);
+        }
+        ring.drop(1);
+        CHECK(ring.space() == 0);
+        ring.pop_gap();
+        ring.drop(1);
+        CHECK(ring.space() == 8);
+
+        uint32_t entries = 0;
+        uint32_t total = 0;
+        while (ring.peek_gap(before, count))
+        {
+            CHECK(before == 0);
+            total += count;
+            ++entries;
+            ring.pop_gap();
+        }
+        CHECK(entries == audio::sample_ring::max_gaps);
+        CHECK(total == audio::sample_ring::max_gaps + 1);
+
+        ring.drop(3);
+        ring.skip_gaps();
+        CHECK(ring.peek_gap(before, count) == false);
+    }
+
+    void test_generator_accounting(void)
+    {
+        mpu::audio_state const audio = tone();
+
+        // 44100 / 60 is whole
+        audio::generator even(44100, audio::offline_capacity);
+        for (int frame = 0; frame < 10; ++frame)
+        {
+            even.frame(true, audio);
+            CHECK(even.ring().available() == (frame + 1) * 735u);
+        }
+
+        // 1000 / 60 is not, the fraction is carried to the next frames
+        audio::generator odd(1000, 2048);
+        uint32_t last = 0;
+        for (int frame = 0; frame < 120; ++frame)
+        {
+            odd.frame(frame & 1, audio);
+            uint32_t const count = odd.ring().available() - last;
+            CHECK(count == 16 || count == 17);
+            last = odd.ring().available();
+        }
+        CHECK(odd.get_samples() == 2000);
+        CHECK(odd.ring().available() == 2000);
+    }
+
+    void test_wav(void)
+    {
+        char const *path = "audio_test.wav";
+        mpu::audio_state const audio = tone();
+
+        // 16 + 17 + 17 samples fill 50 of 64, the next 16 are dropped at 50
+        audio::generator source(1000, 64);
+        for (int frame = 0; frame < 4; ++frame)
+        {
+            source.frame(true, audio);
+        }
+        CHECK(source.ring().available() == 50);
+
+        // a consumer catches up partway and the next frame fits again
+        source.ring().discard(20);
+        source.frame(true, audio);
+        CHECK(source.ring().available() == 47);
+
+        audio::wav_sink sink(path);
+        CHECK(sink.open(source));
+        sink.close();
+        CHECK(sink.size() == 30 + 16 + 17);
+
+        std::vector<uint8_t> file(44 + 2 * 64);
+        FILE *in = fopen(path, "rb");
+        CHECK(in != nullptr);
+        if (in == nullptr)
+        {
+            return;
+        }
+        size_t const size = fread(file.data(), 1, file.size(), in);
+        fclose(in);
+        remove(path);
+
+        CHECK(size == 44 + 2 * 63);
+        CHECK(memcmp(&file[0], "RIFF", 4) == 0);
+        CHECK(get32(&file[4]) == 36 + 2 * 63);
+        CHECK(memcmp(&file[8], "WAVEfmt ", 8) == 0);
+        CHECK(get32(&file[24]) == 1000);
+        CHECK(get32(&file[28]) == 2000);
+        CHECK(memcmp(&file[36], "data", 4) == 0);
+        CHECK(get32(&file[40]) == 2 * 63);
+
+        // the silence sits where the samples were dropped, not at the end
+        for (uint32_t n = 0; n < 63; ++n)
+        {
+            int16_t const sample = static_cast<int16_t>(file[44 + 2 * n] | (file[45 + 2 * n] << 8));
+            bool const gap = n >= 30 && n < 46;
+            CHECK(sample == (gap ? 0 : audio::default_amplitude));
+        }
+    }
+}
+
+int main(void)
+{
+    test_ring_wraparound();
+    test_ring_gaps();
+    test_generator_accounting();
+    test_wav();
+
+    if (s_failures)
+    {
+        printf("audio_test: %d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("audio_test passed\n");
+    return 0;
+}
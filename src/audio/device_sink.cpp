@@ -0,0 +1,164 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "device_sink.h"
+#include "debug.h"
+
+#include <soundio/soundio.h>
+
+#include <algorithm>
+
+audio::device_sink::device_sink() :
+    soundio(nullptr),
+    device(nullptr),
+    stream(nullptr),
+    source(nullptr)
+{
+}
+
+audio::device_sink::~device_sink()
+{
+    close();
+}
+
+bool audio::device_sink::open(generator &from)
+{
+    close();
+    source = &from;
+
+    // sized up front, the device callback never allocates
+    buffer.assign(from.rate() * max_latency_ms / 1000, 0);
+
+    soundio = soundio_create();
+    if (soundio == nullptr || soundio_connect(soundio) != 0)
+    {
+        TRACE_ERROR("audio::device_sink::open cannot connect to an audio backend");
+        close();
+        return false;
+    }
+    soundio_flush_events(soundio);
+
+    int const index = soundio_default_output_device_index(soundio);
+    device = index < 0 ? nullptr : soundio_get_output_device(soundio, index);
+    if (device == nullptr)
+    {
+        TRACE_ERROR("audio::device_sink::open no output device");
+        close();
+        return false;
+    }
+
+    stream = soundio_outstream_create(device);
+    if (stream == nullptr)
+    {
+        TRACE_ERROR("audio::device_sink::open cannot create an output stream");
+        close();
+        return false;
+    }
+    stream->userdata = this;
+    stream->write_callback = &device_sink::write_callback;
+    stream->sample_rate = from.rate();
+    stream->software_latency = max_latency_ms / 2000.0;
+    stream->format = soundio_device_supports_format(device, SoundIoFormatS16NE) ?
+                     SoundIoFormatS16NE : SoundIoFormatFloat32NE;
+
+    if (soundio_outstream_open(stream) != 0 || stream->layout_error ||
+        soundio_outstream_start(stream) != 0)
+    {
+        TRACE_ERROR("audio::device_sink::open cannot start the output stream");
+        close();
+        return false;
+    }
+
+    TRACE_VERBOSE("audio::device_sink::open {} Hz, {} channels", stream->sample_rate, stream->layout.channel_count);
+    return true;
+}
+
+void audio::device_sink::close(void)
+{
+    if (stream)
+    {
+        soundio_outstream_destroy(stream);
+    }
+    if (device)
+    {
+        soundio_device_unref(device);
+    }
+    if (soundio)
+    {
+        soundio_destroy(soundio);
+    }
+    stream = nullptr;
+    device = nullptr;
+    soundio = nullptr;
+}
+
+void audio::device_sink::write_callback(SoundIoOutStream *stream, int frameCountMin, int frameCountMax)
+{
+    static_cast<device_sink*>(stream->userdata)->write(frameCountMin, frameCountMax);
+}
+
+void audio::device_sink::write(int frameCountMin, int frameCountMax)
+{
+    sample_ring &ring = source->ring();
+
+    // drop what piled up beyond the latency budget, the remaining samples
+    // belong to the frames being emulated right now
+    uint32_t const budget = source->rate() * max_latency_ms / 1000;
+    if (ring.available() > budget)
+    {
+        ring.discard(ring.available() - budget);
+    }
+    ring.skip_gaps(); // drops are not padded live, late audio is worse than a click
+
+    // at least what the device needs, silence once the ring and buffer run dry
+    int framesLeft = std::max<int>(frameCountMin, std::min<int>(frameCountMax, buffer.size()));
+    while (framesLeft > 0)
+    {
+        SoundIoChannelArea *areas;
+        int frameCount = std::min<int>(framesLeft, buffer.size());
+        if (soundio_outstream_begin_write(stream, &areas, &frameCount) != 0 || frameCount == 0)
+        {
+            break;
+        }
+
+        uint32_t const popped = ring.pop(buffer.data(), frameCount);
+        std::fill(buffer.begin() + popped, buffer.begin() + frameCount, 0); // underrun plays silence
+
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            for (int channel = 0; channel < stream->layout.channel_count; ++channel)
+            {
+                char *out = areas[channel].ptr + areas[channel].step * frame;
+                if (stream->format == SoundIoFormatS16NE)
+                {
+                    *reinterpret_cast<int16_t*>(out) = buffer[frame];
+                }
+                else
+                {
+                    *reinterpret_cast<float*>(out) = buffer[frame] / 32768.0f;
+                }
+            }
+        }
+
+        soundio_outstream_end_write(stream);
+        framesLeft -= frameCount;
+    }
+}
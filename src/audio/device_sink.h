@@ -0,0 +1,59 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __DEVICE_SINK_H__
+#define __DEVICE_SINK_H__
+
+#include "audio.h"
+
+struct SoundIo;
+struct SoundIoDevice;
+struct SoundIoOutStream;
+
+namespace audio
+{
+    // default output device through libsoundio, fed from the ring by the
+    // device callback. When emulation runs ahead (fast-forward) the backlog
+    // beyond max_latency is skipped so sound stays with the current frame.
+    class device_sink : public sink
+    {
+        public:
+            const static uint32_t max_latency_ms = 100;
+
+            device_sink();
+            virtual ~device_sink();
+
+            virtual bool open(generator &source);
+            virtual void close(void);
+
+        private:
+            SoundIo              *soundio;
+            SoundIoDevice        *device;
+            SoundIoOutStream     *stream;
+            generator            *source;
+            std::vector<int16_t>  buffer;
+
+            static void write_callback(SoundIoOutStream *stream, int frameCountMin, int frameCountMax);
+            void write(int frameCountMin, int frameCountMax);
+    };
+}
+
+#endif//__DEVICE_SINK_H__
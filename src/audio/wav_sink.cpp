@@ -0,0 +1,181 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "audio.h"
+#include "debug.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    const uint32_t wav_header_size = 44;
+    const uint32_t drain_ms        = 2;
+
+    void put16(uint8_t *out, uint16_t value)
+    {
+        out[0] = value;
+        out[1] = value >> 8;
+    }
+
+    void put32(uint8_t *out, uint32_t value)
+    {
+        put16(out, value);
+        put16(out + 2, value >> 16);
+    }
+}
+
+audio::wav_sink::wav_sink(std::string const &path) :
+    path(path),
+    file(nullptr),
+    source(nullptr),
+    stop(false),
+    written(0),
+    gaps(0)
+{
+}
+
+audio::wav_sink::~wav_sink()
+{
+    close();
+}
+
+bool audio::wav_sink::open(generator &from)
+{
+    close();
+
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        TRACE_ERROR("audio::wav_sink::open cannot create file");
+        return false;
+    }
+
+    source = &from;
+    written = 0;
+    gaps = 0;
+    write_header(); // sizes are patched by close()
+
+    stop = false;
+    thread = std::thread(&wav_sink::run, this);
+    return true;
+}
+
+void audio::wav_sink::close(void)
+{
+    if (file == nullptr)
+    {
+        return;
+    }
+
+    stop = true;
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+
+    write_header();
+    fclose(file);
+    file = nullptr;
+
+    if (gaps)
+    {
+        TRACE_WARN("audio::wav_sink {} of {} samples were dropped and written as silence", gaps, written);
+    }
+}
+
+void audio::wav_sink::run(void)
+{
+    std::vector<int16_t> buffer(source->ring().capacity());
+    while (stop == false)
+    {
+        // keep going while the producer keeps the ring busy
+        if (drain(buffer) < buffer.size() / 4)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(drain_ms));
+        }
+    }
+    drain(buffer);
+}
+
+uint32_t audio::wav_sink::drain(std::vector<int16_t> &buffer)
+{
+    sample_ring &ring = source->ring();
+
+    // gaps up to this point are published before the samples after them
+    uint32_t ready = ring.available();
+    uint32_t total = 0;
+    for (;;)
+    {
+        uint32_t before = 0;
+        uint32_t gap = 0;
+        bool const atGap = ring.peek_gap(before, gap);
+
+        uint32_t const want  = std::min<uint32_t>(atGap ? std::min(before, ready) : ready, buffer.size());
+        uint32_t const count = ring.pop(buffer.data(), want);
+        fwrite(buffer.data(), sizeof(int16_t), count, file);
+        written += count;
+        total += count;
+        ready -= count;
+
+        if (atGap == false || count < before)
+        {
+            return total;
+        }
+
+        // the producer dropped these here, pad them in place
+        ring.pop_gap();
+        gaps += gap;
+        written += gap;
+        std::fill(buffer.begin(), buffer.end(), 0);
+        while (gap)
+        {
+            uint32_t const chunk = std::min<uint32_t>(gap, buffer.size());
+            fwrite(buffer.data(), sizeof(int16_t), chunk, file);
+            gap -= chunk;
+        }
+    }
+}
+
+void audio::wav_sink::write_header(void)
+{
+    uint32_t const rate  = source->rate();
+    uint32_t const bytes = static_cast<uint32_t>(written * sizeof(int16_t));
+
+    uint8_t header[wav_header_size];
+    memcpy(header, "RIFF", 4);
+    put32(header + 4, bytes + wav_header_size - 8);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put32(header + 16, 16);        // fmt chunk size
+    put16(header + 20, 1);         // PCM
+    put16(header + 22, 1);         // mono
+    put32(header + 24, rate);
+    put32(header + 28, rate * sizeof(int16_t));
+    put16(header + 32, sizeof(int16_t));
+    put16(header + 34, 16);        // bits per sample
+    memcpy(header + 36, "data", 4);
+    put32(header + 40, bytes);
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), file);
+    fseek(file, 0, SEEK_END);
+}
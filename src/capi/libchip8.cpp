@@ -0,0 +1,259 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "libchip8.h"
+
+#include "chip8.h"
+#include "rom.h"
+#include "thread_pool.h"
+
+static_assert(CHIP8_MEMORY_SIZE    == mpu::chip8::memory_size,      "libchip8.h out of sync");
+static_assert(CHIP8_NUM_REGISTERS  == mpu::chip8::num,              "libchip8.h out of sync");
+static_assert(CHIP8_STACK_DEPTH    == mpu::chip8::stack_depth,      "libchip8.h out of sync");
+static_assert(CHIP8_NUM_KEYS       == mpu::chip8::num_keys,         "libchip8.h out of sync");
+static_assert(CHIP8_DISPLAY_WIDTH  == mpu::framebuffer::width,      "libchip8.h out of sync");
+static_assert(CHIP8_DISPLAY_HEIGHT == mpu::framebuffer::height,     "libchip8.h out of sync");
+
+struct chip8_instance
+{
+    mpu::chip8 cpu;
+    uint32_t   instructions;
+
+    chip8_instance() : cpu(mpu::hardware_hooks()), instructions(mpu::chip8::default_frame_instructions) {}
+};
+
+struct chip8_pool
+{
+    util::thread_pool threads;
+
+    explicit chip8_pool(uint32_t count) : threads(count) {}
+};
+
+namespace
+{
+    // jobs handed to the pool per thread, enough to even out instances that
+    // run slower than others without paying for a job per instance
+    const uint32_t jobs_per_thread = 4;
+
+    // nothing may unwind through the C ABI, and the only things that throw
+    // below are allocations (bad_alloc) and a pool's threads and locks
+    template <typename Body>
+    chip8_status guarded(Body body)
+    {
+        try
+        {
+            return body();
+        }
+        catch (...)
+        {
+            return CHIP8_ERROR_MEMORY;
+        }
+    }
+
+    chip8_status boot(chip8_instance *instance, rom::image_ptr const &image)
+    {
+        if (image == nullptr)
+        {
+            return CHIP8_ERROR_ROM;
+        }
+        image->boot(instance->cpu);
+        return CHIP8_OK;
+    }
+
+    void step(chip8_instance *instance, uint16_t const *keys, uint32_t frames)
+    {
+        if (keys)
+        {
+            instance->cpu.set_keys(*keys);
+        }
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            instance->cpu.frame(instance->instructions);
+        }
+    }
+}
+
+uint32_t chip8_api_version(void)
+{
+    return CHIP8_API_VERSION;
+}
+
+chip8_instance* chip8_create(uint32_t seed)
+{
+    chip8_instance *instance = nullptr;
+    guarded([&]() {
+        instance = new chip8_instance();
+        if (seed)
+        {
+            instance->cpu.seed(seed);
+        }
+        return CHIP8_OK;
+    });
+    return instance;
+}
+
+void chip8_destroy(chip8_instance *instance)
+{
+    delete instance;
+}
+
+chip8_status chip8_reset(chip8_instance *instance)
+{
+    if (instance == nullptr)
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    instance->cpu.init();
+    return CHIP8_OK;
+}
+
+chip8_status chip8_load_rom(chip8_instance *instance, uint8_t const *data, size_t size)
+{
+    if (instance == nullptr || (data == nullptr && size))
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    return guarded([&]() { return boot(instance, rom::cache::instance().load(data, size)); });
+}
+
+chip8_status chip8_load_rom_file(chip8_instance *instance, char const *path)
+{
+    if (instance == nullptr || path == nullptr)
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    return guarded([&]() { return boot(instance, rom::cache::instance().load(std::string(path))); });
+}
+
+chip8_status chip8_set_key(chip8_instance *instance, uint32_t key, int pressed)
+{
+    if (instance == nullptr || key >= mpu::chip8::num_keys)
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    instance->cpu.set_key(key, pressed != 0);
+    return CHIP8_OK;
+}
+
+chip8_status chip8_set_keys(chip8_instance *instance, uint16_t mask)
+{
+    if (instance == nullptr)
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    instance->cpu.set_keys(mask);
+    return CHIP8_OK;
+}
+
+chip8_status chip8_set_frame_instructions(chip8_instance *instance, uint32_t instructions)
+{
+    if (instance == nullptr)
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    instance->instructions = instructions;
+    return CHIP8_OK;
+}
+
+chip8_status chip8_get_view(chip8_instance const *instance, chip8_view *view)
+{
+    if (instance == nullptr || view == nullptr)
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+
+    mpu::state_view const state = instance->cpu.view();
+    view->v           = state.v;
+    view->i           = state.i;
+    view->pc          = state.pc;
+    view->sp          = state.sp;
+    view->stack       = state.stack;
+    view->delay       = state.delay;
+    view->sound       = state.sound;
+    view->keys        = state.keys;
+    view->cycles      = state.cycles;
+    view->frames      = state.frames;
+    view->faults      = state.faults;
+    view->memory      = state.memory;
+    view->framebuffer = state.rows;
+    return CHIP8_OK;
+}
+
+chip8_pool* chip8_pool_create(uint32_t threads)
+{
+    chip8_pool *pool = nullptr;
+    guarded([&]() {
+        pool = new chip8_pool(threads);
+        return CHIP8_OK;
+    });
+    return pool;
+}
+
+void chip8_pool_destroy(chip8_pool *pool)
+{
+    delete pool;
+}
+
+chip8_status chip8_step_frames(chip8_pool *pool,
+                               chip8_instance *const *instances,
+                               uint16_t const *keys,
+                               uint32_t count,
+                               uint32_t frames)
+{
+    if (instances == nullptr && count)
+    {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    for (uint32_t n = 0; n < count; ++n)
+    {
+        if (instances[n] == nullptr)
+        {
+            return CHIP8_ERROR_ARGUMENT;
+        }
+    }
+
+    if (count == 0)
+    {
+        return CHIP8_OK;
+    }
+
+    if (pool == nullptr || pool->threads.size() == 1 || count == 1)
+    {
+        for (uint32_t n = 0; n < count; ++n)
+        {
+            step(instances[n], keys ? &keys[n] : nullptr, frames);
+        }
+        return CHIP8_OK;
+    }
+
+    uint32_t const jobs  = pool->threads.size() * jobs_per_thread;
+    uint32_t const chunk = (count + jobs - 1) / jobs;
+    return guarded([&]() {
+        pool->threads.parallel_for((count + chunk - 1) / chunk, [&](uint32_t job) {
+            uint32_t const end = (job + 1) * chunk < count ? (job + 1) * chunk : count;
+            for (uint32_t n = job * chunk; n < end; ++n)
+            {
+                step(instances[n], keys ? &keys[n] : nullptr, frames);
+            }
+        });
+        return CHIP8_OK;
+    });
+}
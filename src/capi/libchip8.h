@@ -0,0 +1,128 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __LIBCHIP8_H__
+#define __LIBCHIP8_H__
+
+/*
+ * libchip8: stable C ABI over the emulator core.
+ *
+ * Instances are opaque handles. chip8_step_frames advances any number of
+ * them in one call, spread over the threads of a chip8_pool. Observations
+ * are read in place: chip8_get_view returns pointers into the instance
+ * that stay valid until it is destroyed, so polling state costs no calls
+ * and no copies. Do not read an instance while a step involving it runs.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define CHIP8_API __declspec(dllexport)
+#else
+#define CHIP8_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHIP8_API_VERSION 1
+
+#define CHIP8_MEMORY_SIZE      4096
+#define CHIP8_NUM_REGISTERS    16
+#define CHIP8_STACK_DEPTH      16
+#define CHIP8_NUM_KEYS         16
+#define CHIP8_DISPLAY_WIDTH    64
+#define CHIP8_DISPLAY_HEIGHT   32
+
+typedef enum chip8_status
+{
+    CHIP8_OK             = 0,
+    CHIP8_ERROR_ARGUMENT = -1, /* null handle, key out of range, ... */
+    CHIP8_ERROR_ROM      = -2, /* ROM missing, empty or larger than memory */
+    CHIP8_ERROR_MEMORY   = -3, /* allocation failed, or a pool could not get its threads */
+} chip8_status;
+
+typedef struct chip8_instance chip8_instance;
+typedef struct chip8_pool     chip8_pool;
+
+/* live state of one instance, see the header comment */
+typedef struct chip8_view
+{
+    uint8_t const  *v;      /* V0..VF */
+    uint16_t const *i;
+    uint16_t const *pc;
+    uint16_t const *sp;
+    uint16_t const *stack;  /* CHIP8_STACK_DEPTH entries */
+    uint8_t const  *delay;
+    uint8_t const  *sound;
+    uint16_t const *keys;   /* bit n = key n down */
+    uint64_t const *cycles;
+    uint64_t const *frames;
+    uint32_t const *faults;
+    uint8_t const  *memory; /* CHIP8_MEMORY_SIZE bytes */
+    uint64_t const *framebuffer; /* CHIP8_DISPLAY_HEIGHT rows, bit 63 is x = 0 */
+} chip8_view;
+
+CHIP8_API uint32_t chip8_api_version(void);
+
+/* seed 0 uses the default seed, CXNN is deterministic per seed. null when out of memory */
+CHIP8_API chip8_instance* chip8_create(uint32_t seed);
+CHIP8_API void chip8_destroy(chip8_instance *instance);
+
+/* back to power-on state, keeps the seed and instructions per frame */
+CHIP8_API chip8_status chip8_reset(chip8_instance *instance);
+
+/* reset and boot a program, identical ROMs share one decoded image */
+CHIP8_API chip8_status chip8_load_rom(chip8_instance *instance, uint8_t const *data, size_t size);
+CHIP8_API chip8_status chip8_load_rom_file(chip8_instance *instance, char const *path);
+
+CHIP8_API chip8_status chip8_set_key(chip8_instance *instance, uint32_t key, int pressed);
+CHIP8_API chip8_status chip8_set_keys(chip8_instance *instance, uint16_t mask);
+/* default 10, about 600 instructions per second */
+CHIP8_API chip8_status chip8_set_frame_instructions(chip8_instance *instance, uint32_t instructions);
+
+CHIP8_API chip8_status chip8_get_view(chip8_instance const *instance, chip8_view *view);
+
+/*
+ * threads == 0 uses one per core, the thread calling chip8_step_frames counts
+ * as one. null when out of memory or threads
+ */
+CHIP8_API chip8_pool* chip8_pool_create(uint32_t threads);
+CHIP8_API void chip8_pool_destroy(chip8_pool *pool);
+
+/*
+ * advances count instances by frames 60Hz frames each. keys, if not null,
+ * holds one key mask per instance applied before stepping. pool may be null
+ * to step on the calling thread. Handles must be distinct.
+ */
+CHIP8_API chip8_status chip8_step_frames(chip8_pool *pool,
+                                         chip8_instance *const *instances,
+                                         uint16_t const *keys,
+                                         uint32_t count,
+                                         uint32_t frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif/*__LIBCHIP8_H__*/
@@ -0,0 +1,76 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/* libchip8_test: C API smoke test, run by ctest */
+
+#include "libchip8.h"
+
+#include <stdio.h>
+
+#define CHECK(expr)                                                 \
+    do                                                              \
+    {                                                               \
+        if (!(expr))                                                \
+        {                                                           \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+            return 1;                                               \
+        }                                                           \
+    } while (0)
+
+int main(void)
+{
+    /* 6000 7001 1202: count up V0 forever */
+    static uint8_t const program[] = { 0x60, 0x00, 0x70, 0x01, 0x12, 0x02 };
+    enum { instances = 8 };
+
+    chip8_pool *pool = chip8_pool_create(4);
+    chip8_instance *batch[instances];
+    chip8_view view;
+    uint32_t n;
+
+    CHECK(pool != NULL);
+    for (n = 0; n < instances; ++n)
+    {
+        batch[n] = chip8_create(n + 1);
+        CHECK(batch[n] != NULL);
+        CHECK(chip8_load_rom(batch[n], program, sizeof(program)) == CHIP8_OK);
+    }
+
+    /* an empty batch is a no-op on every path */
+    CHECK(chip8_step_frames(pool, NULL, NULL, 0, 1) == CHIP8_OK);
+    CHECK(chip8_step_frames(pool, batch, NULL, 0, 1) == CHIP8_OK);
+    CHECK(chip8_step_frames(NULL, batch, NULL, 0, 1) == CHIP8_OK);
+    CHECK(chip8_get_view(batch[0], &view) == CHIP8_OK);
+    CHECK(*view.frames == 0);
+
+    CHECK(chip8_step_frames(pool, batch, NULL, instances, 3) == CHIP8_OK);
+    for (n = 0; n < instances; ++n)
+    {
+        CHECK(chip8_get_view(batch[n], &view) == CHIP8_OK);
+        CHECK(*view.frames == 3);
+        chip8_destroy(batch[n]);
+    }
+
+    chip8_pool_destroy(pool);
+    printf("libchip8_test passed\n");
+    return 0;
+}
@@ -0,0 +1,386 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "compat.h"
+#include "recorder.h"
+#include "rom.h"
+#include "telemetry.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+
+namespace
+{
+    const uint32_t    default_frames = 600;
+    std::string const rom_extension  = ".ch8";
+
+    typedef std::pair<uint32_t, uint64_t> checkpoint; // frame, framebuffer hash
+
+    struct key_event
+    {
+        uint32_t frame;
+        uint8_t  key;
+        bool     pressed;
+    };
+
+    struct rom_test
+    {
+        enum status
+        {
+            pass,
+            fail,
+            recorded,
+            error,
+        };
+
+        std::string             name;
+        std::string             path; // without extension
+        uint32_t                frames = default_frames;
+        uint32_t                ipf    = mpu::chip8::default_frame_instructions;
+        std::vector<key_event>  events;
+        std::vector<uint32_t>   checks;
+        std::vector<checkpoint> golden;
+
+        status                  result = error;
+        std::string             message;
+        std::vector<checkpoint> hashes;
+        double                  milliseconds = 0;
+        uint64_t                cycles = 0;
+    };
+
+    bool read_script(rom_test &test)
+    {
+        std::ifstream file(test.path + ".input");
+        if (!file)
+        {
+            return true; // optional
+        }
+
+        std::string line;
+        uint32_t lineNumber = 0;
+        while (std::getline(file, line))
+        {
+            ++lineNumber;
+            line = line.substr(0, line.find('#'));
+
+            std::istringstream in(line);
+            std::string command;
+            if (!(in >> command))
+            {
+                continue;
+            }
+
+            bool ok = false;
+            if (command == "frames")
+            {
+                ok = static_cast<bool>(in >> test.frames);
+            }
+            else if (command == "ipf")
+            {
+                ok = static_cast<bool>(in >> test.ipf);
+            }
+            else if (command == "press" || command == "release")
+            {
+                key_event event;
+                uint32_t key;
+                ok = static_cast<bool>(in >> event.frame >> std::hex >> key) && key < mpu::chip8::num_keys;
+                event.key = key;
+                event.pressed = (command == "press");
+                test.events.push_back(event);
+            }
+            else if (command == "check")
+            {
+                uint32_t frame;
+                ok = static_cast<bool>(in >> frame);
+                test.checks.push_back(frame);
+            }
+
+            if (ok == false)
+            {
+                test.message = test.name + ".input:" + std::to_string(lineNumber) + ": cannot parse \"" + line + "\"";
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool read_golden(rom_test &test)
+    {
+        std::ifstream file(test.path + ".golden");
+        std::string line;
+        uint32_t lineNumber = 0;
+        while (std::getline(file, line))
+        {
+            ++lineNumber;
+
+            std::istringstream in(line);
+            std::string frame, hash, extra;
+            if (!(in >> frame))
+            {
+                continue;
+            }
+
+            // runs on a pool worker, a throwing parse would terminate the suite
+            char *frameEnd = nullptr;
+            char *hashEnd = nullptr;
+            errno = 0;
+            unsigned long const at = strtoul(frame.c_str(), &frameEnd, 10);
+            unsigned long long const value = (in >> hash) ? strtoull(hash.c_str(), &hashEnd, 16) : 0;
+            if (*frameEnd != '\0' || at > UINT32_MAX || hashEnd == nullptr || hashEnd == hash.c_str() ||
+                *hashEnd != '\0' || errno == ERANGE || (in >> extra))
+            {
+                test.message = test.name + ".golden:" + std::to_string(lineNumber) + ": cannot parse \"" + line + "\"";
+                return false;
+            }
+            test.golden.push_back(checkpoint(static_cast<uint32_t>(at), value));
+        }
+
+        return true;
+    }
+
+    bool write_golden(rom_test const &test)
+    {
+        std::ofstream file(test.path + ".golden");
+        char line[64];
+        for (auto const &check : test.hashes)
+        {
+            snprintf(line, sizeof(line), "%u %016llx\n", check.first, static_cast<unsigned long long>(check.second));
+            file << line;
+        }
+        return static_cast<bool>(file);
+    }
+
+    void run_test(rom_test &test, compat::options const &opt, debug::telemetry_slot &slot)
+    {
+        auto const start = std::chrono::steady_clock::now();
+
+        rom::image_ptr image = rom::cache::instance().load(test.path + rom_extension);
+        if (image == nullptr)
+        {
+            test.message = "cannot load ROM (missing, empty or larger than memory)";
+            return;
+        }
+        if (read_script(test) == false)
+        {
+            return;
+        }
+        if (read_golden(test) == false)
+        {
+            return;
+        }
+
+        if (test.checks.empty())
+        {
+            test.checks.push_back(test.frames);
+        }
+        std::sort(test.checks.begin(), test.checks.end());
+        std::stable_sort(test.events.begin(), test.events.end(),
+            [](key_event const &a, key_event const &b) { return a.frame < b.frame; });
+
+        // headless, no display hook unless recording
+        platform::recorder recorder;
+        mpu::hardware_hooks hooks;
+        if (opt.record.empty() == false && recorder.open(opt.record + "/" + test.name + ".y4m"))
+        {
+            hooks.pDisplay = &recorder;
+        }
+        mpu::chip8 cpu(hooks);
+        image->boot(cpu);
+
+        auto event = test.events.begin();
+        auto check = test.checks.begin();
+        for (uint32_t frame = 0; frame < test.frames && check != test.checks.end(); ++frame)
+        {
+            for (; event != test.events.end() && event->frame == frame; ++event)
+            {
+                cpu.set_key(event->key, event->pressed);
+            }
+
+            cpu.frame(test.ipf);
+            slot.publish(cpu, debug::telemetry::now());
+
+            for (; check != test.checks.end() && *check == frame + 1; ++check)
+            {
+                test.hashes.push_back(checkpoint(frame + 1, compat::hash(cpu.display())));
+            }
+        }
+
+        test.cycles = cpu.get_cycles();
+        test.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (opt.update)
+        {
+            test.result = rom_test::recorded;
+            return;
+        }
+        if (test.golden.empty())
+        {
+            // a missing or misnamed golden must not pass silently
+            test.result = rom_test::fail;
+            test.message = "no hashes in " + test.name + ".golden, run with -u to record them";
+            return;
+        }
+
+        test.result = rom_test::pass;
+        for (auto const &expected : test.golden)
+        {
+            auto actual = std::find_if(test.hashes.begin(), test.hashes.end(),
+                [&](checkpoint const &c) { return c.first == expected.first; });
+
+            char text[128];
+            if (actual == test.hashes.end())
+            {
+                snprintf(text, sizeof(text), "frame %u: no checkpoint, add \"check %u\" to %s.input",
+                         expected.first, expected.first, test.name.c_str());
+            }
+            else if (actual->second != expected.second)
+            {
+                snprintf(text, sizeof(text), "frame %u: expected %016llx, got %016llx", expected.first,
+                         static_cast<unsigned long long>(expected.second),
+                         static_cast<unsigned long long>(actual->second));
+            }
+            else
+            {
+                continue;
+            }
+
+            test.result = rom_test::fail;
+            test.message = text;
+            break;
+        }
+    }
+
+    // false if directory cannot be read, a ROM file passed by mistake included
+    bool list_roms(std::string const &directory, std::vector<std::string> &names)
+    {
+        DIR *dir = opendir(directory.c_str());
+        if (dir == nullptr)
+        {
+            return false;
+        }
+
+        while (dirent *entry = readdir(dir))
+        {
+            std::string file(entry->d_name);
+            if (file.size() > rom_extension.size() &&
+                file.compare(file.size() - rom_extension.size(), rom_extension.size(), rom_extension) == 0)
+            {
+                names.push_back(file.substr(0, file.size() - rom_extension.size()));
+            }
+        }
+        closedir(dir);
+
+        std::sort(names.begin(), names.end());
+        return true;
+    }
+}
+
+uint64_t compat::hash(mpu::framebuffer const& fb)
+{
+    // FNV-1a over the packed rows
+    uint64_t value = 0xCBF29CE484222325ull;
+    for (uint32_t y = 0; y < mpu::framebuffer::height; ++y)
+    {
+        for (uint32_t shift = 0; shift < 64; shift += 8)
+        {
+            value ^= (fb.rows[y] >> shift) & 0xFF;
+            value *= 0x100000001B3ull;
+        }
+    }
+    return value;
+}
+
+int compat::run_suite(options const& opt)
+{
+    std::vector<std::string> names;
+    if (list_roms(opt.directory, names) == false)
+    {
+        printf("compat: \"%s\" is not a readable directory\n", opt.directory.c_str());
+        return 1;
+    }
+
+    std::vector<rom_test> tests;
+    for (auto const &name : names)
+    {
+        rom_test test;
+        test.name = name;
+        test.path = opt.directory + "/" + name;
+        tests.push_back(test);
+    }
+
+    if (tests.empty())
+    {
+        printf("compat: no %s ROMs found in \"%s\"\n", rom_extension.c_str(), opt.directory.c_str());
+        return 1;
+    }
+
+    util::thread_pool pool(opt.threads);
+    auto const start = std::chrono::steady_clock::now();
+
+    // one telemetry slot per ROM while it runs, chip8_top shows the outcome
+    pool.parallel_for(tests.size(), [&](uint32_t index) {
+        static debug::telemetry_slot::status_code const s_outcome[] = {
+            debug::telemetry_slot::passed, debug::telemetry_slot::failed,
+            debug::telemetry_slot::recorded, debug::telemetry_slot::error };
+
+        debug::telemetry_slot &slot = debug::telemetry::instance().claim(tests[index].name);
+        run_test(tests[index], opt, slot);
+        slot.set_status(s_outcome[tests[index].result]);
+        debug::telemetry::instance().release(slot);
+    });
+
+    double const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    static char const *const s_status[] = { "PASS", "FAIL", "NEW ", "ERR " };
+    int failures = 0;
+    for (auto &test : tests)
+    {
+        if (test.result == rom_test::recorded && write_golden(test) == false)
+        {
+            test.result = rom_test::error;
+            test.message = "cannot write " + test.name + ".golden";
+        }
+        if (test.result == rom_test::fail || test.result == rom_test::error)
+        {
+            ++failures;
+        }
+
+        printf("%s %-32s %8.1fms %12llu cycles  %s\n",
+               s_status[test.result], test.name.c_str(), test.milliseconds,
+               static_cast<unsigned long long>(test.cycles), test.message.c_str());
+    }
+
+    printf("compat: %u ROMs, %d failed, %.2fs on %u threads\n",
+           static_cast<uint32_t>(tests.size()), failures, elapsed, pool.size());
+
+    return failures;
+}
@@ -0,0 +1,59 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __COMPAT_H__
+#define __COMPAT_H__
+
+#include <cstdint>
+#include <string>
+
+#include "chip8.h"
+
+// headless ROM compatibility suite
+//
+// every "<name>.ch8" in the directory is run for a fixed number of frames.
+// an optional "<name>.input" script drives it:
+//      frames 600          total frames to run (default 600)
+//      ipf 10              instructions per frame
+//      press 120 5         key 5 goes down before frame 120
+//      release 130 5       key 5 goes up before frame 130
+//      check 300           hash the framebuffer after frame 300 (default: last frame)
+// hashes are compared against "<name>.golden" ("<frame> <hash>" per line),
+// which update mode (re)writes; without update mode a ROM lacking one fails.
+// with a record directory every run is also
+// captured to "<record>/<name>.y4m".
+namespace compat
+{
+    struct options
+    {
+        std::string directory;
+        uint32_t    threads = 0; // 0 = one per core
+        bool        update  = false;
+        std::string record;
+    };
+
+    uint64_t hash(mpu::framebuffer const& fb);
+
+    // returns the number of failing ROMs
+    int run_suite(options const& opt);
+}
+
+#endif//__COMPAT_H__
@@ -21,13 +21,10 @@
 // SOFTWARE.
 #include "debug.h"
 
-#include <atomic>
-#include <iostream>
 #include <list>
 #include <mutex>
 #include <algorithm>
 
-static std::atomic<bool> s_debugEnabled(false);
 static std::mutex s_sanityListMutex;
 static std::list<debug::isanity_testable*> s_sanityList;
 
@@ -41,26 +38,18 @@ debug::isanity_testable::isanity_testable()
 debug::isanity_testable::~isanity_testable()
 {
     s_sanityListMutex.lock();
-    std::remove(s_sanityList.begin(), s_sanityList.end(), this);
+    s_sanityList.remove(this);
     s_sanityListMutex.unlock();
 }
 
 void debug::enable(void)
 {
-    s_debugEnabled = true;
+    set_trace_level(trace_verbose);
 }
 
 void debug::disable(void)
 {
-    s_debugEnabled = false;
-}
-
-void debug::trace(std::string const &message)
-{
-    if (s_debugEnabled)
-    {
-        std::cout << "tr>> " << message << std::endl;
-    }
+    set_trace_level(trace_off);
 }
 
 void debug::test_sanity(void)
@@ -69,4 +58,6 @@ void debug::test_sanity(void)
     {
         object->test_sanity();
     }
+
+    trace_flush();
 }
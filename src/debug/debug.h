@@ -23,7 +23,8 @@
 #define __DEBUG_H__
 
 #include <cstdint>
-#include <string>
+
+#include "trace.h"
 
 namespace debug
 {
@@ -38,7 +39,6 @@ namespace debug
     void enable(void);
     void disable(void);
     void test_sanity(void);
-    void trace(std::string const &message);
 }
 
 #endif//__DEBUG_H__
@@ -0,0 +1,442 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "debugger.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    char const *const s_compareNames[] = { "", "==", "!=", "<", ">", "<=", ">=" };
+
+    bool parse_number(std::string const& text, uint32_t &value)
+    {
+        // addresses and values are hex, with or without 0x
+        char *end = nullptr;
+        unsigned long parsed = strtoul(text.c_str(), &end, 16);
+        if (text.empty() || *end != '\0')
+        {
+            return false;
+        }
+        value = static_cast<uint32_t>(parsed);
+        return true;
+    }
+
+    std::string describe(debug::debugger::condition const& when)
+    {
+        if (when.op == debug::debugger::always)
+        {
+            return std::string();
+        }
+
+        char buffer[32];
+        if (when.reg == debug::debugger::condition::reg_i)
+        {
+            snprintf(buffer, sizeof(buffer), " if I %s %X", s_compareNames[when.op], when.value);
+        }
+        else
+        {
+            snprintf(buffer, sizeof(buffer), " if V%X %s %X", when.reg, s_compareNames[when.op], when.value);
+        }
+        return buffer;
+    }
+
+    void help(std::ostream &out)
+    {
+        out << "b ADDR [Vx|I OP VALUE]  break at ADDR, OP is one of == != < > <= >=\n"
+               "d ADDR                  delete the breakpoint at ADDR\n"
+               "w FIRST [LAST]          stop after an instruction writes FIRST..LAST\n"
+               "u FIRST [LAST]          stop watching FIRST..LAST\n"
+               "i                       list breakpoints and watched ranges\n"
+               "c                       continue\n"
+               "s [N]                   execute N instructions (default 1)\n"
+               "r                       show registers\n"
+               "x ADDR [LEN]            dump LEN bytes of memory (default 10)\n"
+               "l [ADDR] [N]            disassemble N instructions (default pc, 8)\n"
+               "q                       quit\n"
+               "numbers are hex\n";
+    }
+}
+
+debug::debugger::debugger(uint32_t frameInstructions) :
+    frameInstructions(frameInstructions)
+{
+}
+
+void debug::debugger::add_breakpoint(mpu::chip8 &cpu, uint16_t address, condition const& when)
+{
+    address &= mpu::chip8::address_mask;
+    conditions[address] = when;
+    cpu.set_breakpoint(address, true);
+}
+
+void debug::debugger::remove_breakpoint(mpu::chip8 &cpu, uint16_t address)
+{
+    address &= mpu::chip8::address_mask;
+    conditions.erase(address);
+    cpu.set_breakpoint(address, false);
+}
+
+void debug::debugger::watch(mpu::chip8 &cpu, uint16_t first, uint16_t last, bool enabled)
+{
+    for (uint32_t address = first; address <= last && address < mpu::chip8::memory_size; ++address)
+    {
+        cpu.set_watchpoint(address, enabled);
+    }
+}
+
+bool debug::debugger::breakpoint(mpu::chip8 const& cpu, uint16_t pc)
+{
+    condition when;
+    std::map<uint16_t, condition>::const_iterator found = conditions.find(pc);
+    if (found != conditions.end())
+    {
+        when = found->second;
+    }
+
+    uint16_t const actual = when.reg == condition::reg_i ? cpu.get_i() :
+                            cpu.get_register(static_cast<mpu::chip8::reg>(when.reg & 0xF));
+    bool hit = true;
+    switch (when.op)
+    {
+        case always:        hit = true;                   break;
+        case equal:         hit = actual == when.value;   break;
+        case not_equal:     hit = actual != when.value;   break;
+        case less:          hit = actual <  when.value;   break;
+        case greater:       hit = actual >  when.value;   break;
+        case less_equal:    hit = actual <= when.value;   break;
+        case greater_equal: hit = actual >= when.value;   break;
+    }
+
+    if (hit)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "breakpoint at %03X", pc);
+        stopReason = buffer + describe(when);
+    }
+    return hit;
+}
+
+bool debug::debugger::watchpoint(mpu::chip8 const& cpu, uint16_t address, uint8_t value)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "watchpoint %03X = %02X, written at %03X",
+             address, value, cpu.get_pc());
+    stopReason = buffer;
+    return true;
+}
+
+bool debug::debugger::parse_condition(std::string const& text, condition &when)
+{
+    std::istringstream words(text);
+    std::string reg, op, value;
+    if (!(words >> reg))
+    {
+        when = condition();
+        return true;
+    }
+    if (!(words >> op >> value))
+    {
+        return false;
+    }
+
+    uint32_t number = 0;
+    if (reg == "I" || reg == "i")
+    {
+        when.reg = condition::reg_i;
+    }
+    else if (reg.size() == 2 && (reg[0] == 'V' || reg[0] == 'v') &&
+             parse_number(reg.substr(1), number))
+    {
+        when.reg = static_cast<uint8_t>(number);
+    }
+    else
+    {
+        return false;
+    }
+
+    when.op = always;
+    for (uint32_t i = equal; i <= greater_equal; ++i)
+    {
+        if (op == s_compareNames[i])
+        {
+            when.op = static_cast<compare>(i);
+        }
+    }
+
+    if (when.op == always || parse_number(value, number) == false)
+    {
+        return false;
+    }
+    when.value = static_cast<uint16_t>(number);
+    return true;
+}
+
+bool debug::debugger::prompt(mpu::chip8 &cpu, std::istream &in, std::ostream &out)
+{
+    if (stopReason.empty() == false)
+    {
+        out << stopReason << "\n";
+        stopReason.clear();
+    }
+    list(cpu, cpu.get_pc(), 1, out);
+
+    std::string line;
+    while (out << "(chip8) " << std::flush, std::getline(in, line))
+    {
+        std::istringstream words(line);
+        std::string command, first, second;
+        words >> command >> first >> second;
+
+        uint32_t a = 0, b = 0;
+        bool const haveA = parse_number(first, a);
+        bool const haveB = parse_number(second, b);
+
+        if (command.empty())
+        {
+            continue;
+        }
+        else if (command == "b" && haveA)
+        {
+            condition when;
+            std::string rest;
+            std::getline(words, rest);
+            if (parse_condition(second + rest, when) == false)
+            {
+                out << "bad condition, expected Vx|I OP VALUE\n";
+                continue;
+            }
+            add_breakpoint(cpu, static_cast<uint16_t>(a), when);
+        }
+        else if (command == "d" && haveA)
+        {
+            remove_breakpoint(cpu, static_cast<uint16_t>(a));
+        }
+        else if ((command == "w" || command == "u") && haveA)
+        {
+            watch(cpu, static_cast<uint16_t>(a), static_cast<uint16_t>(haveB ? b : a), command == "w");
+        }
+        else if (command == "i")
+        {
+            char buffer[64];
+            for (auto const& entry : conditions)
+            {
+                snprintf(buffer, sizeof(buffer), "break %03X", entry.first);
+                out << buffer << describe(entry.second) << "\n";
+            }
+            for (uint32_t address = 0; address < mpu::chip8::memory_size; ++address)
+            {
+                if (cpu.get_watchpoint(address))
+                {
+                    uint32_t const first = address;
+                    while (address + 1 < mpu::chip8::memory_size && cpu.get_watchpoint(address + 1))
+                    {
+                        ++address;
+                    }
+                    snprintf(buffer, sizeof(buffer), "watch %03X..%03X", first, address);
+                    out << buffer << "\n";
+                }
+            }
+        }
+        else if (command == "c")
+        {
+            // don't stop on the breakpoint we are sitting on
+            cpu.resume();
+            return true;
+        }
+        else if (command == "s")
+        {
+            for (uint32_t n = haveA ? a : 1; n; --n)
+            {
+                cpu.resume();
+                cpu.step(frameInstructions);
+                if (stopReason.empty() == false)
+                {
+                    // a watchpoint or breakpoint hit mid-step ends it early
+                    out << stopReason << "\n";
+                    stopReason.clear();
+                    break;
+                }
+            }
+            list(cpu, cpu.get_pc(), 1, out);
+        }
+        else if (command == "r")
+        {
+            registers(cpu, out);
+        }
+        else if (command == "x" && haveA)
+        {
+            uint8_t const *mem = cpu.memory();
+            char buffer[8];
+            uint32_t const len = haveB ? b : 0x10;
+            for (uint32_t offset = 0; offset < len; ++offset)
+            {
+                uint32_t const address = (a + offset) & mpu::chip8::address_mask;
+                if (offset % 16 == 0)
+                {
+                    snprintf(buffer, sizeof(buffer), "%03X:", address);
+                    out << (offset ? "\n" : "") << buffer;
+                }
+                snprintf(buffer, sizeof(buffer), " %02X", mem[address]);
+                out << buffer;
+            }
+            out << "\n";
+        }
+        else if (command == "l")
+        {
+            list(cpu, static_cast<uint16_t>(haveA ? a : cpu.get_pc()), haveB ? b : 8, out);
+        }
+        else if (command == "q")
+        {
+            return false;
+        }
+        else
+        {
+            help(out);
+        }
+    }
+
+    return false;
+}
+
+std::string debug::debugger::disassemble(uint16_t op)
+{
+    char buffer[32];
+    uint32_t const x   = (op & 0x0F00) >> 8u;
+    uint32_t const y   = (op & 0x00F0) >> 4u;
+    uint32_t const n   = (op & 0x000F);
+    uint32_t const kk  = (op & 0x00FF);
+    uint32_t const nnn = (op & 0x0FFF);
+
+    // mnemonics follow Cowgod's technical reference
+    switch (op & 0xF000)
+    {
+        case 0x0000:
+            switch (op)
+            {
+                case 0x0000: return "NOP";
+                case 0x00E0: return "CLS";
+                case 0x00EE: return "RET";
+            }
+            break;
+
+        case 0x1000: snprintf(buffer, sizeof(buffer), "JP %03X", nnn);            return buffer;
+        case 0x2000: snprintf(buffer, sizeof(buffer), "CALL %03X", nnn);          return buffer;
+        case 0x3000: snprintf(buffer, sizeof(buffer), "SE V%X, %02X", x, kk);     return buffer;
+        case 0x4000: snprintf(buffer, sizeof(buffer), "SNE V%X, %02X", x, kk);    return buffer;
+
+        case 0x5000:
+            if (n == 0)
+            {
+                snprintf(buffer, sizeof(buffer), "SE V%X, V%X", x, y);
+                return buffer;
+            }
+            break;
+
+        case 0x6000: snprintf(buffer, sizeof(buffer), "LD V%X, %02X", x, kk);     return buffer;
+        case 0x7000: snprintf(buffer, sizeof(buffer), "ADD V%X, %02X", x, kk);    return buffer;
+
+        case 0x8000:
+        {
+            static char const *const s_alu[16] = {
+                "LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+                nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "SHL", nullptr,
+            };
+            if (s_alu[n])
+            {
+                snprintf(buffer, sizeof(buffer), "%s V%X, V%X", s_alu[n], x, y);
+                return buffer;
+            }
+            break;
+        }
+
+        case 0x9000: snprintf(buffer, sizeof(buffer), "SNE V%X, V%X", x, y);      return buffer;
+        case 0xA000: snprintf(buffer, sizeof(buffer), "LD I, %03X", nnn);         return buffer;
+        case 0xB000: snprintf(buffer, sizeof(buffer), "JP V0, %03X", nnn);        return buffer;
+        case 0xC000: snprintf(buffer, sizeof(buffer), "RND V%X, %02X", x, kk);    return buffer;
+        case 0xD000: snprintf(buffer, sizeof(buffer), "DRW V%X, V%X, %X", x, y, n); return buffer;
+
+        case 0xE000:
+            switch (kk)
+            {
+                case 0x9E: snprintf(buffer, sizeof(buffer), "SKP V%X", x);  return buffer;
+                case 0xA1: snprintf(buffer, sizeof(buffer), "SKNP V%X", x); return buffer;
+            }
+            break;
+
+        case 0xF000:
+            switch (kk)
+            {
+                case 0x02: return "AUDIO";
+                case 0x07: snprintf(buffer, sizeof(buffer), "LD V%X, DT", x);  return buffer;
+                case 0x0A: snprintf(buffer, sizeof(buffer), "LD V%X, K", x);   return buffer;
+                case 0x15: snprintf(buffer, sizeof(buffer), "LD DT, V%X", x);  return buffer;
+                case 0x18: snprintf(buffer, sizeof(buffer), "LD ST, V%X", x);  return buffer;
+                case 0x1E: snprintf(buffer, sizeof(buffer), "ADD I, V%X", x);  return buffer;
+                case 0x29: snprintf(buffer, sizeof(buffer), "LD F, V%X", x);   return buffer;
+                case 0x33: snprintf(buffer, sizeof(buffer), "LD B, V%X", x);   return buffer;
+                case 0x3A: snprintf(buffer, sizeof(buffer), "PITCH V%X", x);   return buffer;
+                case 0x55: snprintf(buffer, sizeof(buffer), "LD [I], V%X", x); return buffer;
+                case 0x65: snprintf(buffer, sizeof(buffer), "LD V%X, [I]", x); return buffer;
+            }
+            break;
+    }
+
+    snprintf(buffer, sizeof(buffer), "DW %04X", op);
+    return buffer;
+}
+
+void debug::debugger::list(mpu::chip8 const& cpu, uint16_t address, uint32_t count, std::ostream &out)
+{
+    uint8_t const *mem = cpu.memory();
+    char buffer[32];
+    for (; count; --count, address += 2u)
+    {
+        address &= mpu::chip8::address_mask;
+        uint16_t const op = (mem[address] << 8u) | mem[(address + 1) & mpu::chip8::address_mask];
+        snprintf(buffer, sizeof(buffer), "%c%c %03X  %04X  ",
+                 address == cpu.get_pc() ? '>' : ' ',
+                 cpu.get_breakpoint(address) ? '*' : ' ',
+                 address, op);
+        out << buffer << disassemble(op) << "\n";
+    }
+}
+
+void debug::debugger::registers(mpu::chip8 const& cpu, std::ostream &out)
+{
+    char buffer[64];
+    for (uint32_t r = 0; r < mpu::chip8::reg::num; ++r)
+    {
+        snprintf(buffer, sizeof(buffer), "V%X=%02X%c", r,
+                 cpu.get_register(static_cast<mpu::chip8::reg>(r)), r % 8 == 7 ? '\n' : ' ');
+        out << buffer;
+    }
+    snprintf(buffer, sizeof(buffer), "I=%03X PC=%03X SP=%X DT=%02X ST=%02X keys=%04X\n",
+             cpu.get_i(), cpu.get_pc(), cpu.get_sp(), cpu.get_delay(), cpu.get_sound(), cpu.get_keys());
+    out << buffer;
+    snprintf(buffer, sizeof(buffer), "cycles=%llu frames=%llu faults=%u\n",
+             static_cast<unsigned long long>(cpu.get_cycles()),
+             static_cast<unsigned long long>(cpu.get_frames()), cpu.get_faults());
+    out << buffer;
+}
@@ -0,0 +1,91 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __DEBUGGER_H__
+#define __DEBUGGER_H__
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+
+#include "chip8.h"
+
+namespace debug
+{
+    // interactive debugger driven through mpu::debug_hook. The cpu keeps the
+    // breakpoint and watchpoint bitmaps, this only adds conditions and the
+    // command prompt, so a run without breakpoints executes as usual.
+    class debugger : public mpu::debug_hook
+    {
+        public:
+            enum compare
+            {
+                always = 0,
+                equal,
+                not_equal,
+                less,
+                greater,
+                less_equal,
+                greater_equal,
+            };
+
+            // stop only when V[reg] (or I for reg == reg_i) compares true against value
+            struct condition
+            {
+                const static uint8_t reg_i = 16;
+
+                uint8_t  reg;
+                compare  op;
+                uint16_t value;
+
+                condition() : reg(0), op(always), value(0) {}
+            };
+
+            debugger(uint32_t frameInstructions = mpu::chip8::default_frame_instructions);
+
+            void add_breakpoint(mpu::chip8 &cpu, uint16_t address, condition const& when = condition());
+            void remove_breakpoint(mpu::chip8 &cpu, uint16_t address);
+            void watch(mpu::chip8 &cpu, uint16_t first, uint16_t last, bool enabled);
+
+            bool breakpoint(mpu::chip8 const& cpu, uint16_t pc) override;
+            bool watchpoint(mpu::chip8 const& cpu, uint16_t address, uint8_t value) override;
+
+            // why the cpu last stopped, empty before the first stop
+            std::string const& reason(void) const { return stopReason; }
+
+            // reads commands until one resumes execution, false to quit
+            bool prompt(mpu::chip8 &cpu, std::istream &in, std::ostream &out);
+
+            static std::string disassemble(uint16_t op);
+            static void list(mpu::chip8 const& cpu, uint16_t address, uint32_t count, std::ostream &out);
+            static void registers(mpu::chip8 const& cpu, std::ostream &out);
+
+        private:
+            uint32_t frameInstructions;
+            std::map<uint16_t, condition> conditions;
+            std::string stopReason;
+
+            static bool parse_condition(std::string const& text, condition &when);
+    };
+}
+
+#endif//__DEBUGGER_H__
@@ -0,0 +1,312 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "instruction_log.h"
+#include "trace.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static char const s_magic[8] = { 'C', '8', 'I', 'T', 'R', 'A', 'C', 'E' };
+
+debug::instruction_log::instruction_log() :
+    fd(-1),
+    segmentIndex(0),
+    segment(nullptr),
+    cursor(nullptr),
+    end(nullptr),
+    count(0),
+    lastFaults(0)
+{
+}
+
+debug::instruction_log::~instruction_log()
+{
+    close();
+}
+
+bool debug::instruction_log::open(std::string const &path)
+{
+    close();
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        TRACE_ERROR("instruction_log::open failed to create trace file");
+        return false;
+    }
+
+    instruction_log_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, s_magic, sizeof(header.magic));
+    header.version     = version;
+    header.record_size = sizeof(instruction_record);
+
+    if (pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        map_segment(0) == false)
+    {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    count = 0;
+    lastFaults = 0;
+
+    TRACE_VERBOSE("instruction_log::open completed.");
+    return true;
+}
+
+void debug::instruction_log::close(void)
+{
+    if (fd < 0)
+    {
+        return;
+    }
+
+    unmap_segment();
+
+    // trim the unused tail of the last segment and publish the record count
+    if (ftruncate(fd, header_size + count * sizeof(instruction_record)) != 0)
+    {
+        TRACE_WARN("instruction_log::close failed to trim trace file");
+    }
+    if (pwrite(fd, &count, sizeof(count), offsetof(instruction_log_header, record_count)) !=
+        static_cast<ssize_t>(sizeof(count)))
+    {
+        TRACE_WARN("instruction_log::close failed to write record count");
+    }
+
+    ::close(fd);
+    fd = -1;
+
+    TRACE_VERBOSE("instruction_log::close {} records", count);
+}
+
+bool debug::instruction_log::map_segment(size_t index)
+{
+    unmap_segment();
+
+    off_t const offset = header_size + index * segment_size;
+    if (ftruncate(fd, offset + segment_size) != 0)
+    {
+        TRACE_ERROR("instruction_log failed to grow trace file to segment {}", index);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    if (mapping == MAP_FAILED)
+    {
+        TRACE_ERROR("instruction_log failed to map segment {}", index);
+        return false;
+    }
+    madvise(mapping, segment_size, MADV_SEQUENTIAL);
+
+    segmentIndex = index;
+    segment = static_cast<instruction_record*>(mapping);
+    cursor  = segment;
+    end     = segment + segment_records;
+    return true;
+}
+
+void debug::instruction_log::unmap_segment(void)
+{
+    if (segment)
+    {
+        munmap(segment, segment_size);
+        segment = cursor = end = nullptr;
+    }
+}
+
+void debug::instruction_log::retire(mpu::chip8 const& cpu, uint16_t pc, uint16_t op)
+{
+    if (cursor == end)
+    {
+        if (fd < 0)
+        {
+            return;
+        }
+        if (map_segment(segmentIndex + 1) == false)
+        {
+            // keep what was recorded and stop, instead of retrying on every instruction
+            TRACE_WARN("instruction_log::retire cannot grow the trace, logging stopped after {} records", count);
+            close();
+            return;
+        }
+    }
+
+    uint8_t const  x   = (op & 0x0F00) >> 8u;
+    uint8_t const *mem = cpu.memory();
+
+    instruction_record record;
+    record.cycle     = cpu.get_cycles() - 1;
+    record.pc        = pc;
+    record.op        = op;
+    record.i         = cpu.get_i();
+    record.mem_addr  = 0;
+    record.mem_len   = 0;
+    record.mem_value = 0;
+    record.reg       = instruction_record::no_register;
+    record.reg_value = 0;
+    record.vf        = cpu.get_register(mpu::chip8::vF);
+    record.sp        = cpu.get_sp();
+    record.flags     = instruction_record::valid;
+    record.reserved  = 0;
+
+    if (cpu.get_faults() != lastFaults)
+    {
+        lastFaults = cpu.get_faults();
+        record.flags |= instruction_record::hardfault;
+    }
+
+    // derive the destination register and memory write from the opcode,
+    // keeping the cost out of chip8::clock when tracing is off
+    switch (op & 0xF000)
+    {
+        case 0x6000:
+        case 0x7000:
+        case 0x8000:
+        case 0xC000:
+            record.reg = x;
+            break;
+
+        case 0xF000:
+            switch (op & 0x00FF)
+            {
+                case 0x07:
+                case 0x0A:
+                case 0x65:
+                    record.reg = x;
+                    break;
+
+                case 0x33:
+                    record.mem_addr = record.i;
+                    record.mem_len  = 3;
+                    break;
+
+                case 0x55:
+                    // V0..Vx inclusive, nothing when I + x overflowed and faulted
+                    if ((record.flags & instruction_record::hardfault) == 0)
+                    {
+                        record.mem_addr = record.i;
+                        record.mem_len  = x + 1;
+                    }
+                    break;
+            }
+            break;
+    }
+
+    if (record.reg != instruction_record::no_register)
+    {
+        record.reg_value = cpu.get_register(static_cast<mpu::chip8::reg>(record.reg));
+    }
+    if (record.mem_len)
+    {
+        record.mem_value = mem[record.mem_addr & (mpu::chip8::memory_size - 1)];
+    }
+    *cursor++ = record;
+    ++count;
+}
+
+debug::instruction_log_reader::instruction_log_reader() :
+    mapping(nullptr),
+    mappingSize(0),
+    records(nullptr),
+    count(0)
+{
+}
+
+debug::instruction_log_reader::~instruction_log_reader()
+{
+    close();
+}
+
+bool debug::instruction_log_reader::open(std::string const &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < instruction_log::header_size)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    mappingSize = info.st_size;
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        mapping = nullptr;
+        return false;
+    }
+
+    instruction_log_header const *header = static_cast<instruction_log_header const*>(mapping);
+    if (memcmp(header->magic, s_magic, sizeof(s_magic)) != 0 ||
+        header->version != instruction_log::version ||
+        header->record_size != sizeof(instruction_record))
+    {
+        close();
+        return false;
+    }
+    madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+
+    records = reinterpret_cast<instruction_record const*>(
+        static_cast<uint8_t const*>(mapping) + instruction_log::header_size);
+    count = (mappingSize - instruction_log::header_size) / sizeof(instruction_record);
+
+    if (header->record_count && header->record_count <= count)
+    {
+        count = header->record_count;
+    }
+    else
+    {
+        // writer did not close, drop the zeroed tail of the last segment
+        while (count && (records[count - 1].flags & instruction_record::valid) == 0)
+        {
+            --count;
+        }
+    }
+
+    return true;
+}
+
+void debug::instruction_log_reader::close(void)
+{
+    if (mapping)
+    {
+        munmap(mapping, mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    records = nullptr;
+    count = 0;
+}
@@ -0,0 +1,121 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __INSTRUCTION_LOG_H__
+#define __INSTRUCTION_LOG_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "chip8.h"
+
+namespace debug
+{
+    // one fixed size record per retired instruction
+    struct instruction_record
+    {
+        enum flag
+        {
+            valid     = 0x80, // set on every written record
+            hardfault = 0x01, // instruction raised a hardfault
+        };
+        const static uint8_t no_register = 0xFF;
+
+        uint64_t cycle;
+        uint16_t pc;
+        uint16_t op;
+        uint16_t i;         // I after execution
+        uint16_t mem_addr;  // first byte written, valid when mem_len != 0
+        uint8_t  mem_len;
+        uint8_t  mem_value; // first byte written
+        uint8_t  reg;       // destination Vx, or no_register
+        uint8_t  reg_value; // Vx after execution
+        uint8_t  vf;        // VF after execution
+        uint8_t  sp;
+        uint8_t  flags;
+        uint8_t  reserved;
+    };
+    static_assert(sizeof(instruction_record) == 24, "instruction_record is a file format");
+
+    struct instruction_log_header
+    {
+        char     magic[8]; // "C8ITRACE"
+        uint32_t version;
+        uint32_t record_size;
+        uint64_t record_count; // 0 if the writer did not close cleanly
+        uint64_t reserved;
+    };
+
+    // appends instruction records to a file through memory-mapped segments
+    class instruction_log : public mpu::trace_hook
+    {
+        public:
+            const static uint32_t version = 1;
+            const static size_t   header_size = 4096;                // records start on the 2nd page
+            const static size_t   segment_records = 1u << 21;        // 48MiB per mapping
+            const static size_t   segment_size = segment_records * sizeof(instruction_record);
+
+            instruction_log();
+            ~instruction_log();
+
+            bool open(std::string const &path);
+            void close(void);
+            bool is_open(void) const { return fd >= 0; }
+            uint64_t size(void) const { return count; }
+
+            virtual void retire(mpu::chip8 const& cpu, uint16_t pc, uint16_t op);
+
+        private:
+            int                 fd;
+            size_t              segmentIndex;
+            instruction_record *segment;
+            instruction_record *cursor;
+            instruction_record *end;
+            uint64_t            count;
+            uint32_t            lastFaults;
+
+            bool map_segment(size_t index);
+            void unmap_segment(void);
+    };
+
+    // read-only view of a complete instruction log
+    class instruction_log_reader
+    {
+        public:
+            instruction_log_reader();
+            ~instruction_log_reader();
+
+            bool open(std::string const &path);
+            void close(void);
+
+            uint64_t size(void) const { return count; }
+            instruction_record const& operator[](uint64_t index) const { return records[index]; }
+
+        private:
+            void                     *mapping;
+            size_t                    mappingSize;
+            instruction_record const *records;
+            uint64_t                  count;
+    };
+}
+
+#endif//__INSTRUCTION_LOG_H__
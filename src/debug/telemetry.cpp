@@ -0,0 +1,270 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "telemetry.h"
+#include "trace.h"
+
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static char const s_magic[8]  = { 'C', '8', 'T', 'E', 'L', 'E', 'M', '1' };
+static char const s_prefix[]  = "chip8.";
+
+debug::telemetry& debug::telemetry::instance(void)
+{
+    static telemetry s_telemetry;
+    return s_telemetry;
+}
+
+uint64_t debug::telemetry::now(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+debug::telemetry::telemetry() :
+    header(nullptr),
+    slots(nullptr)
+{
+}
+
+debug::telemetry::~telemetry()
+{
+    close();
+}
+
+bool debug::telemetry::open(void)
+{
+    if (is_open())
+    {
+        return true;
+    }
+
+    segmentName = "/" + std::string(s_prefix) + std::to_string(getpid());
+    int fd = shm_open(segmentName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        TRACE_WARN("telemetry::open cannot create shared memory segment, errno {}", errno);
+        return false;
+    }
+
+    if (ftruncate(fd, segment_size) != 0)
+    {
+        TRACE_WARN("telemetry::open cannot size shared memory segment, errno {}", errno);
+        ::close(fd);
+        shm_unlink(segmentName.c_str());
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        TRACE_WARN("telemetry::open cannot map shared memory segment, errno {}", errno);
+        shm_unlink(segmentName.c_str());
+        return false;
+    }
+
+    // fresh pages are zero, every slot starts unused
+    header = static_cast<telemetry_header*>(mapping);
+    slots  = reinterpret_cast<telemetry_slot*>(header + 1);
+
+    header->version    = version;
+    header->slot_count = slot_count;
+    header->slot_size  = sizeof(telemetry_slot);
+    header->pid        = getpid();
+    header->start_ns   = now();
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, s_magic, sizeof(s_magic));
+
+    TRACE_VERBOSE("telemetry::open publishing {} slots", slot_count);
+    return true;
+}
+
+void debug::telemetry::close(void)
+{
+    if (header)
+    {
+        munmap(header, segment_size);
+        shm_unlink(segmentName.c_str());
+    }
+    header = nullptr;
+    slots = nullptr;
+}
+
+debug::telemetry_slot& debug::telemetry::claim(std::string const &label)
+{
+    // per thread, so workers that found no shared slot still never write
+    // each other's counters
+    static thread_local telemetry_slot s_private;
+    telemetry_slot *slot = &s_private;
+
+    // prefer a slot that was never used, then recycle a finished one
+    for (uint32_t wanted = telemetry_slot::unused; slots && slot == &s_private && wanted <= telemetry_slot::finished; ++wanted)
+    {
+        if (wanted == telemetry_slot::active)
+        {
+            continue;
+        }
+        for (uint32_t n = 0; n < slot_count; ++n)
+        {
+            uint32_t expected = wanted;
+            if (slots[n].slot_state.compare_exchange_strong(expected, telemetry_slot::active, std::memory_order_acquire))
+            {
+                slot = &slots[n];
+                break;
+            }
+        }
+    }
+
+    if (slot == &s_private && slots)
+    {
+        TRACE_WARN("telemetry::claim all {} slots are in use", slot_count);
+    }
+
+    uint64_t const start = now();
+    slot->status.store(telemetry_slot::running, std::memory_order_relaxed);
+    slot->instructions.store(0, std::memory_order_relaxed);
+    slot->frames.store(0, std::memory_order_relaxed);
+    slot->presented.store(0, std::memory_order_relaxed);
+    slot->faults.store(0, std::memory_order_relaxed);
+    slot->start_ns.store(start, std::memory_order_relaxed);
+    slot->updated_ns.store(start, std::memory_order_relaxed);
+    for (auto &bucket : slot->update_ns)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    if (slot != &s_private)
+    {
+        strncpy(slot->name, label.c_str(), sizeof(slot->name) - 1);
+        slot->name[sizeof(slot->name) - 1] = 0;
+    }
+    return *slot;
+}
+
+void debug::telemetry::release(telemetry_slot &slot)
+{
+    if (shared(slot))
+    {
+        slot.updated_ns.store(now(), std::memory_order_relaxed);
+        slot.slot_state.store(telemetry_slot::finished, std::memory_order_release);
+    }
+}
+
+debug::telemetry_reader::telemetry_reader() :
+    mapping(nullptr),
+    mappingSize(0),
+    header(nullptr),
+    slots(nullptr)
+{
+}
+
+debug::telemetry_reader::~telemetry_reader()
+{
+    close();
+}
+
+std::vector<std::string> debug::telemetry_reader::list(void)
+{
+    std::vector<std::string> names;
+
+    // POSIX shared memory objects live in /dev/shm on Linux
+    DIR *dir = opendir("/dev/shm");
+    if (dir == nullptr)
+    {
+        return names;
+    }
+    while (dirent *entry = readdir(dir))
+    {
+        if (strncmp(entry->d_name, s_prefix, sizeof(s_prefix) - 1) == 0)
+        {
+            names.push_back(std::string("/") + entry->d_name);
+        }
+    }
+    closedir(dir);
+    return names;
+}
+
+bool debug::telemetry_reader::open(std::string const &name)
+{
+    close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(telemetry_header))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    mappingSize = info.st_size;
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        mapping = nullptr;
+        return false;
+    }
+
+    header = static_cast<telemetry_header const*>(mapping);
+    if (memcmp(header->magic, s_magic, sizeof(s_magic)) != 0 ||
+        header->version != telemetry::version ||
+        header->slot_size != sizeof(telemetry_slot) ||
+        sizeof(telemetry_header) + static_cast<size_t>(header->slot_count) * sizeof(telemetry_slot) > mappingSize)
+    {
+        close();
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    slots = reinterpret_cast<telemetry_slot const*>(header + 1);
+    return true;
+}
+
+void debug::telemetry_reader::close(void)
+{
+    if (mapping)
+    {
+        munmap(mapping, mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    slots = nullptr;
+}
+
+bool debug::telemetry_reader::alive(void) const
+{
+    return header && (kill(header->pid, 0) == 0 || errno == EPERM);
+}
@@ -0,0 +1,180 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chip8.h"
+
+namespace debug
+{
+    // live counters of one emulator instance, written only by the thread
+    // running it and read concurrently by chip8_top. Each slot starts on its
+    // own cache line so instances on different threads never share one.
+    struct telemetry_slot
+    {
+        enum state
+        {
+            unused = 0,
+            active,   // owned by a running instance
+            finished, // released, keeps its last values until reused
+        };
+
+        enum status_code
+        {
+            idle = 0,
+            running,
+            passed,
+            failed,
+            error,
+            recorded, // compat update mode wrote new golden hashes
+            num_status
+        };
+
+        const static uint32_t name_size = 64;
+        const static uint32_t buckets   = 32; // update time histogram, bucket b = [2^b, 2^(b+1)) ns
+
+        std::atomic<uint32_t> slot_state;
+        std::atomic<uint32_t> status;
+        std::atomic<uint64_t> instructions;
+        std::atomic<uint64_t> frames;       // emulated
+        std::atomic<uint64_t> presented;    // frames handed to display::update()
+        std::atomic<uint64_t> faults;
+        std::atomic<uint64_t> start_ns;     // steady clock, shared by all processes on the host
+        std::atomic<uint64_t> updated_ns;
+        uint8_t               pad[8];
+        char                  name[name_size];
+        std::atomic<uint64_t> update_ns[buckets];
+
+        // single writer, plain load + store instead of a locked read-modify-write
+        static void bump(std::atomic<uint64_t> &counter, uint64_t amount = 1)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        void publish(mpu::chip8 const& cpu, uint64_t now)
+        {
+            instructions.store(cpu.get_cycles(), std::memory_order_relaxed);
+            frames.store(cpu.get_frames(), std::memory_order_relaxed);
+            faults.store(cpu.get_faults(), std::memory_order_relaxed);
+            updated_ns.store(now, std::memory_order_relaxed);
+        }
+
+        void record_update(uint64_t ns)
+        {
+            uint32_t bucket = 0;
+            while (bucket + 1 < buckets && (ns >> (bucket + 1)))
+            {
+                ++bucket;
+            }
+            bump(update_ns[bucket]);
+            bump(presented);
+        }
+
+        void set_status(status_code code) { status.store(code, std::memory_order_relaxed); }
+    };
+    static_assert(sizeof(telemetry_slot) % 64 == 0, "telemetry slots are cache line sized");
+
+    struct telemetry_header
+    {
+        char     magic[8]; // "C8TELEM1"
+        uint32_t version;
+        uint32_t slot_count;
+        uint32_t slot_size;
+        uint32_t pid;
+        uint64_t start_ns;
+        uint8_t  pad[32];
+    };
+    static_assert(sizeof(telemetry_header) == 64, "telemetry_header is a shared layout");
+
+    // process wide shared memory segment "/chip8.<pid>" holding one header
+    // followed by slot_count slots
+    class telemetry
+    {
+        public:
+            const static uint32_t version    = 1;
+            const static uint32_t slot_count = 1024;
+            const static size_t   segment_size = sizeof(telemetry_header) + slot_count * sizeof(telemetry_slot);
+
+            static telemetry& instance(void);
+            static uint64_t now(void);
+
+            ~telemetry();
+
+            bool open(void);
+            void close(void);
+            bool is_open(void) const { return header != nullptr; }
+            std::string const& name(void) const { return segmentName; }
+
+            // never fails. When the segment is not open or every slot is
+            // taken the calling thread gets its own private slot, which is
+            // not published; claim and release it on the same thread.
+            telemetry_slot& claim(std::string const &label);
+            void release(telemetry_slot &slot);
+
+        private:
+            telemetry();
+
+            telemetry_header *header;
+            telemetry_slot   *slots;
+            std::string       segmentName;
+
+            bool shared(telemetry_slot const &slot) const
+            {
+                return slots && &slot >= slots && &slot < slots + slot_count;
+            }
+    };
+
+    // read-only view of another process' telemetry segment
+    class telemetry_reader
+    {
+        public:
+            telemetry_reader();
+            ~telemetry_reader();
+
+            // segment names of every chip8 process on the host
+            static std::vector<std::string> list(void);
+
+            bool open(std::string const &name);
+            void close(void);
+
+            telemetry_header const& info(void) const { return *header; }
+            uint32_t size(void) const { return header ? header->slot_count : 0; }
+            telemetry_slot const& operator[](uint32_t index) const { return slots[index]; }
+
+            // false once the owning process has exited without removing the segment
+            bool alive(void) const;
+
+        private:
+            void                   *mapping;
+            size_t                  mappingSize;
+            telemetry_header const *header;
+            telemetry_slot const   *slots;
+    };
+}
+
+#endif//__TELEMETRY_H__
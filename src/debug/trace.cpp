@@ -0,0 +1,274 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::atomic<int> debug::g_traceLevel(debug::trace_off);
+
+namespace
+{
+    const uint32_t ring_capacity = 1024; // records, power of 2
+    const uint32_t ring_mask     = ring_capacity - 1;
+
+    // single producer (owning thread), single consumer (whoever holds the drain lock)
+    // head and tail are padded onto separate cache lines
+    struct trace_ring
+    {
+        std::atomic<uint32_t> head;    // written by producer
+        std::atomic<uint32_t> dropped; // records lost to a full ring, producer side
+        uint8_t               padHead[64 - 2 * sizeof(std::atomic<uint32_t>)];
+        std::atomic<uint32_t> tail;    // written by consumer
+        std::atomic<bool>     retired; // owning thread has exited
+        uint8_t               padTail[64 - 2 * sizeof(std::atomic<uint32_t>)];
+        debug::trace_record   records[ring_capacity];
+
+        trace_ring() : head(0), dropped(0), tail(0), retired(false) {}
+    };
+
+    class trace_writer
+    {
+        public:
+            trace_writer() : stop(false) {}
+
+            ~trace_writer()
+            {
+                debug::g_traceLevel = debug::trace_off;
+                {
+                    std::lock_guard<std::mutex> lock(wakeMutex);
+                    stop = true;
+                }
+                wake.notify_all();
+                if (thread.joinable())
+                {
+                    thread.join();
+                }
+                drain();
+            }
+
+            void start(void)
+            {
+                std::call_once(started, [this]() {
+                    thread = std::thread(&trace_writer::run, this);
+                });
+            }
+
+            std::shared_ptr<trace_ring> attach(void)
+            {
+                std::shared_ptr<trace_ring> ring = std::make_shared<trace_ring>();
+                std::lock_guard<std::mutex> lock(ringsMutex);
+                rings.push_back(ring);
+                return ring;
+            }
+
+            void drain(void)
+            {
+                std::lock_guard<std::mutex> drainLock(drainMutex);
+
+                std::vector<std::shared_ptr<trace_ring>> snapshot;
+                {
+                    std::lock_guard<std::mutex> lock(ringsMutex);
+                    snapshot = rings;
+                }
+
+                batch.clear();
+                uint32_t dropped = 0;
+                for (auto& ring : snapshot)
+                {
+                    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+                    uint32_t head = ring->head.load(std::memory_order_acquire);
+                    for (; tail != head; ++tail)
+                    {
+                        batch.push_back(ring->records[tail & ring_mask]);
+                    }
+                    ring->tail.store(tail, std::memory_order_release);
+                    dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+                }
+
+                // rings of exited threads are released once empty
+                {
+                    std::lock_guard<std::mutex> lock(ringsMutex);
+                    rings.erase(std::remove_if(rings.begin(), rings.end(),
+                        [](std::shared_ptr<trace_ring> const& ring) {
+                            return ring->retired.load(std::memory_order_acquire) &&
+                                   ring->tail.load(std::memory_order_relaxed) ==
+                                   ring->head.load(std::memory_order_acquire);
+                        }), rings.end());
+                }
+
+                if (batch.empty() && dropped == 0)
+                {
+                    return;
+                }
+
+                std::stable_sort(batch.begin(), batch.end(),
+                    [](debug::trace_record const& a, debug::trace_record const& b) {
+                        return a.timestamp < b.timestamp;
+                    });
+
+                text.clear();
+                for (auto const& record : batch)
+                {
+                    format(record);
+                }
+                if (dropped)
+                {
+                    text += "tr>> " + std::to_string(dropped) + " trace records dropped\n";
+                }
+
+                std::cout << text << std::flush;
+            }
+
+        private:
+            std::once_flag                            started;
+            std::thread                               thread;
+            std::mutex                                wakeMutex;
+            std::condition_variable                   wake;
+            bool                                      stop;
+            std::mutex                                ringsMutex;
+            std::vector<std::shared_ptr<trace_ring>>  rings;
+            std::mutex                                drainMutex;
+            std::vector<debug::trace_record>          batch;
+            std::string                               text;
+
+            void run(void)
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                while (!stop)
+                {
+                    wake.wait_for(lock, std::chrono::milliseconds(10));
+                    lock.unlock();
+                    drain();
+                    lock.lock();
+                }
+            }
+
+            void format(debug::trace_record const& record)
+            {
+                static char const *const s_levelNames[] = { "E", "W", "I", "V" };
+
+                char buffer[32];
+                text += "tr>> ";
+                text += s_levelNames[record.level];
+                text += ' ';
+
+                uint32_t arg = 0;
+                for (char const *p = record.format; *p; ++p)
+                {
+                    if (p[0] == '{' && p[1] == '}')
+                    {
+                        if (arg < record.count)
+                        {
+                            snprintf(buffer, sizeof(buffer), "%llu",
+                                     static_cast<unsigned long long>(record.args[arg++]));
+                            text += buffer;
+                        }
+                        ++p;
+                    }
+                    else if (p[0] == '{' && p[1] == 'x' && p[2] == '}')
+                    {
+                        if (arg < record.count)
+                        {
+                            snprintf(buffer, sizeof(buffer), "0x%llX",
+                                     static_cast<unsigned long long>(record.args[arg++]));
+                            text += buffer;
+                        }
+                        p += 2;
+                    }
+                    else
+                    {
+                        text += *p;
+                    }
+                }
+                text += '\n';
+            }
+    };
+
+    trace_writer& writer(void)
+    {
+        static trace_writer s_writer;
+        return s_writer;
+    }
+
+    // registers the calling thread's ring on first use, retires it on thread exit
+    struct thread_ring
+    {
+        std::shared_ptr<trace_ring> ring;
+
+        thread_ring() : ring(writer().attach()) {}
+        ~thread_ring() { ring->retired.store(true, std::memory_order_release); }
+    };
+
+    uint64_t timestamp(void)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+void debug::set_trace_level(trace_level level)
+{
+    if (level > trace_off)
+    {
+        writer().start();
+    }
+    g_traceLevel = level;
+}
+
+void debug::trace_flush(void)
+{
+    writer().drain();
+}
+
+void debug::trace_push(trace_level level, char const *format, uint64_t const *args, uint32_t count)
+{
+    static thread_local thread_ring s_local;
+    trace_ring& ring = *s_local.ring;
+
+    uint32_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= ring_capacity)
+    {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    trace_record& record = ring.records[head & ring_mask];
+    record.timestamp = timestamp();
+    record.format    = format;
+    record.level     = level;
+    record.count     = count;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        record.args[i] = args[i];
+    }
+
+    ring.head.store(head + 1, std::memory_order_release);
+}
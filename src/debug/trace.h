@@ -0,0 +1,103 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <atomic>
+#include <cstdint>
+
+// highest trace level compiled in, anything above is removed entirely
+// 0 = error, 1 = warn, 2 = info, 3 = verbose
+#ifndef CHIP8_TRACE_LEVEL
+#define CHIP8_TRACE_LEVEL 3
+#endif
+
+// usage: TRACE_ERROR("chip8::clock bad instruction {x} at {x}", op, pc);
+// "{}" formats an argument as decimal, "{x}" as hex. The format must be a
+// string literal, only its address is recorded and formatting happens later
+// on the trace writer thread. Arguments are not evaluated unless the level is
+// both compiled in and enabled at runtime.
+#define DEBUG_TRACE(level, ...)                                            \
+    do                                                                     \
+    {                                                                      \
+        if ((level) <= CHIP8_TRACE_LEVEL && ::debug::trace_enabled(level)) \
+        {                                                                  \
+            ::debug::trace_emit((level), __VA_ARGS__);                     \
+        }                                                                  \
+    } while (0)
+
+#define TRACE_ERROR(...)   DEBUG_TRACE(::debug::trace_error,   __VA_ARGS__)
+#define TRACE_WARN(...)    DEBUG_TRACE(::debug::trace_warn,    __VA_ARGS__)
+#define TRACE_INFO(...)    DEBUG_TRACE(::debug::trace_info,    __VA_ARGS__)
+#define TRACE_VERBOSE(...) DEBUG_TRACE(::debug::trace_verbose, __VA_ARGS__)
+
+namespace debug
+{
+    enum trace_level
+    {
+        trace_off = -1,
+        trace_error = 0,
+        trace_warn,
+        trace_info,
+        trace_verbose,
+    };
+
+    const static uint32_t trace_max_args = 4;
+
+    // fixed size binary record, stored in a per-thread ring buffer
+    struct trace_record
+    {
+        uint64_t    timestamp; // steady clock, nanoseconds
+        char const *format;
+        uint64_t    args[trace_max_args];
+        int32_t     level;
+        uint32_t    count;
+    };
+
+    extern std::atomic<int> g_traceLevel;
+
+    inline bool trace_enabled(trace_level level)
+    {
+        return level <= g_traceLevel.load(std::memory_order_relaxed);
+    }
+
+    void set_trace_level(trace_level level);
+    void trace_flush(void);
+
+    // lock-free push into the calling thread's ring buffer
+    void trace_push(trace_level level, char const *format, uint64_t const *args, uint32_t count);
+
+    inline void trace_emit(trace_level level, char const *format)
+    {
+        trace_push(level, format, nullptr, 0);
+    }
+
+    template <typename... Args>
+    inline void trace_emit(trace_level level, char const *format, Args... args)
+    {
+        static_assert(sizeof...(Args) <= trace_max_args, "too many trace arguments");
+        uint64_t const packed[] = { static_cast<uint64_t>(args)... };
+        trace_push(level, format, packed, sizeof...(Args));
+    }
+}
+
+#endif//__TRACE_H__
@@ -25,34 +25,346 @@
 
 #include <cstring>
 
+static uint8_t const s_font[16 * 5] =
+{
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80, // F
+};
+
+// decoded form of memory right after a reset (the font, zeros elsewhere),
+// built once so init() copies it instead of decoding every address again
+static mpu::decoded_op const* blank_code(void)
+{
+    struct table
+    {
+        mpu::decoded_op code[mpu::chip8::memory_size];
+
+        table()
+        {
+            uint8_t mem[mpu::chip8::memory_size] = {};
+            memcpy(&mem[mpu::chip8::font_start], s_font, sizeof(s_font));
+            for (uint32_t address = 0; address < mpu::chip8::memory_size; ++address)
+            {
+                code[address] = mpu::chip8::decode((mem[address] << 8u) | mem[(address + 1) & mpu::chip8::address_mask]);
+            }
+        }
+    };
+
+    static table const s_blank;
+    return s_blank.code;
+}
+
 mpu::chip8::chip8(hardware_hooks const& hooks) :
-    hooks(hooks)
+    rngSeed(default_seed),
+    hooks(hooks),
+    breakpointCount(0),
+    watchpointCount(0)
 {
+    memset(breakpoints, 0, sizeof(breakpoints));
+    memset(watchpoints, 0, sizeof(watchpoints));
     init();
 }
 
 void mpu::chip8::init(void)
 {
-    debug::trace("chip8::init begin");
+    TRACE_VERBOSE("chip8::init begin");
 
     // system reset, clear all memory
     memset(mem, 0, sizeof(mem));
     memset(v, 0, sizeof(v));
     memset(stack, 0, sizeof(stack));
+    memset(&fb, 0, sizeof(fb));
+    memcpy(&mem[font_start], s_font, sizeof(s_font));
     i = 0;
-    pc = 0;
+    pc = program_start;
     sp = 0;
+    cycles = 0;
+    faults = 0;
+    frames = 0;
+    delay = 0;
+    sound = 0;
+    keys = 0;
+    rng = rngSeed;
+    frameLeft = 0;
+    resumeAt = no_address;
+    armedAt = no_address;
+
+    // until a program loads its own, a 500Hz square wave at the default pitch
+    memset(audio.pattern, 0xF0, sizeof(audio.pattern));
+    audio.pitch = audio_state::default_pitch;
+
+    memcpy(code, blank_code(), sizeof(code));
+
+    // the shared table knows nothing about this instance's breakpoints
+    for (uint32_t address = 0; breakpointCount && address < memory_size; ++address)
+    {
+        if (get_breakpoint(address))
+        {
+            code[address].handler = op_breakpoint;
+        }
+    }
+
+    TRACE_VERBOSE("chip8::init completed.");
+}
+
+void mpu::chip8::seed(uint32_t value)
+{
+    // xorshift never leaves a zero state
+    rngSeed = value ? value : default_seed;
+    rng = rngSeed;
+}
+
+void mpu::chip8::load(uint16_t address, uint8_t const *data, uint32_t size)
+{
+    for (uint32_t n = 0; n < size; ++n)
+    {
+        write_memory((address + n) & address_mask, data[n]);
+    }
+}
+
+void mpu::chip8::boot(uint8_t const *program, uint32_t size, decoded_op const *decoded)
+{
+    init();
+
+    if (size > memory_size - program_start)
+    {
+        TRACE_ERROR("!!!chip8::boot program of {} bytes does not fit!!!", size);
+        hardfault();
+        return;
+    }
+
+    if (decoded == nullptr)
+    {
+        load(program_start, program, size);
+        return;
+    }
+
+    memcpy(&mem[program_start], program, size);
+    memcpy(&code[program_start], decoded, size * sizeof(decoded_op));
+
+    // instructions straddling either end of the program see memory outside it
+    predecode(program_start - 1);
+    predecode((program_start + size - 1) & address_mask);
+
+    // the shared image knows nothing about this instance's breakpoints
+    for (uint32_t address = program_start; breakpointCount && address < program_start + size; ++address)
+    {
+        if (get_breakpoint(address))
+        {
+            code[address].handler = op_breakpoint;
+        }
+    }
+}
+
+uint8_t mpu::chip8::random(void)
+{
+    // xorshift32, deterministic per instance so engines can be compared
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng & 0xFF;
+}
+
+bool mpu::chip8::frame(uint32_t instructions)
+{
+    return advance(instructions, instructions);
+}
+
+bool mpu::chip8::step(uint32_t instructions)
+{
+    return advance(instructions, 1);
+}
+
+bool mpu::chip8::advance(uint32_t instructions, uint32_t limit)
+{
+    if (frameLeft == 0)
+    {
+        frameLeft = instructions;
+    }
+
+    uint32_t const batch = frameLeft < limit ? frameLeft : limit;
+    uint32_t const executed = batch - run(batch);
+    frameLeft -= executed;
+    if (executed)
+    {
+        // the resumed instruction may not have been marked any more
+        resumeAt = no_address;
+    }
+    if (frameLeft)
+    {
+        return false;
+    }
+
+    if (hooks.pAudio)
+    {
+        hooks.pAudio->frame(sound != 0, audio);
+    }
+
+    if (delay) --delay;
+    if (sound) --sound;
+    ++frames;
+
+    if (hooks.pDisplay)
+    {
+        hooks.pDisplay->vblank(fb);
+    }
+    return true;
+}
 
-    debug::trace("chip8::init completed.");
+mpu::state_view mpu::chip8::view(void) const
+{
+    state_view state;
+    state.v      = v;
+    state.i      = &i;
+    state.pc     = &pc;
+    state.sp     = &sp;
+    state.stack  = stack;
+    state.delay  = &delay;
+    state.sound  = &sound;
+    state.keys   = &keys;
+    state.cycles = &cycles;
+    state.frames = &frames;
+    state.faults = &faults;
+    state.memory = mem;
+    state.rows   = fb.rows;
+    return state;
+}
+
+void mpu::chip8::set_key(uint8_t key, bool pressed)
+{
+    uint16_t const bit = 1u << (key & 0xF);
+    keys = pressed ? (keys | bit) : (keys & ~bit);
+}
+
+void mpu::chip8::draw(uint8_t x, uint8_t y, uint8_t n)
+{
+    // sprite origin wraps, the sprite itself clips at the screen edges
+    uint32_t const left = v[x] % framebuffer::width;
+    uint32_t const top  = v[y] % framebuffer::height;
+    uint64_t collision = 0;
+
+    for (uint32_t row = 0; row < n && top + row < framebuffer::height; ++row)
+    {
+        uint64_t const line = (static_cast<uint64_t>(mem[(i + row) & address_mask]) << 56u) >> left;
+        collision |= fb.rows[top + row] & line;
+        fb.rows[top + row] ^= line;
+    }
+
+    v[vF] = collision ? 1 : 0;
+}
+
+bool mpu::chip8::wait_key(uint8_t x)
+{
+    // blocks (by re-executing) until any key is down, stores the lowest one
+    for (uint8_t key = 0; key < num_keys; ++key)
+    {
+        if (keys & (1u << key))
+        {
+            v[x] = key;
+            return true;
+        }
+    }
+    return false;
+}
+
+void mpu::chip8::write_memory(uint16_t address, uint8_t value)
+{
+    mem[address] = value;
+
+    // the byte belongs to the instruction at address and the one before it
+    predecode(address);
+    predecode((address - 1) & address_mask);
+}
+
+void mpu::chip8::store(uint16_t address, uint8_t value)
+{
+    write_memory(address, value);
+
+    if (watchpointCount && get_watchpoint(address) &&
+        (hooks.pDebug == nullptr || hooks.pDebug->watchpoint(*this, address, value)))
+    {
+        // storing instructions always continue with the next one, stop there
+        armedAt = (pc + 2u) & address_mask;
+        code[armedAt].handler = op_breakpoint;
+    }
+}
+
+void mpu::chip8::predecode(uint16_t address)
+{
+    code[address] = decode((mem[address] << 8u) | mem[(address + 1) & address_mask]);
+    if ((breakpointCount && get_breakpoint(address)) || address == armedAt)
+    {
+        code[address].handler = op_breakpoint;
+    }
+}
+
+void mpu::chip8::set_breakpoint(uint16_t address, bool enabled)
+{
+    address &= address_mask;
+    if (get_breakpoint(address) == enabled)
+    {
+        return;
+    }
+
+    breakpoints[address >> 6] ^= 1ull << (address & 63);
+    breakpointCount += enabled ? 1 : -1;
+    predecode(address);
+}
+
+void mpu::chip8::set_watchpoint(uint16_t address, bool enabled)
+{
+    address &= address_mask;
+    if (get_watchpoint(address) == enabled)
+    {
+        return;
+    }
+
+    watchpoints[address >> 6] ^= 1ull << (address & 63);
+    watchpointCount += enabled ? 1 : -1;
+}
+
+bool mpu::chip8::break_here(void)
+{
+    // only reached through op_breakpoint, never on unmarked instructions
+    bool const armed = armedAt == pc;
+    if (armed)
+    {
+        armedAt = no_address;
+        predecode(pc);
+    }
+
+    if (resumeAt == pc)
+    {
+        resumeAt = no_address;
+        return false;
+    }
+
+    return armed || (get_breakpoint(pc) &&
+                     (hooks.pDebug == nullptr || hooks.pDebug->breakpoint(*this, pc)));
 }
 
 void mpu::chip8::hardfault(void)
 {
-    debug::trace("!!!chip8::hardfault invoked!!!");
+    TRACE_ERROR("!!!chip8::hardfault invoked at pc {x}!!!", pc);
     // signal hard fault
+    ++faults;
 
     // reset processor
-    pc = 0;
+    pc = program_start;
     i = 0;
     sp = 0;
 }
@@ -60,9 +372,24 @@ void mpu::chip8::hardfault(void)
 void mpu::chip8::clock(void)
 {
     // fetch current instruction (big endian)
+    // execution wraps at the end of memory
+    pc &= address_mask;
+
+    uint16_t const fetchPc = pc;
     uint16_t op;
-    op = ((mem[pc] << 8u) | mem[pc + 1]);
+    op = ((mem[pc] << 8u) | mem[(pc + 1) & address_mask]);
+
+    execute(op);
+    ++cycles;
 
+    if (hooks.pTrace)
+    {
+        hooks.pTrace->retire(*this, fetchPc, op);
+    }
+}
+
+void mpu::chip8::execute(uint16_t op)
+{
     // decode & execute instruction
     // top level decode -> index 0-F
     switch (op & 0xf000)
@@ -76,14 +403,18 @@ void mpu::chip8::clock(void)
 
                 case 0x00E0:
                     // clear screen
-                    hooks.pDisplay->clear_screen();
+                    memset(&fb, 0, sizeof(fb));
+                    if (hooks.pDisplay)
+                    {
+                        hooks.pDisplay->clear_screen();
+                    }
                     break;
 
                 case 0x00EE:
                     // return from call
                     if (sp == 0)
                     {
-                        debug::trace("!!!chip8::clock (call) stack underflow!!!");
+                        TRACE_ERROR("!!!chip8::clock (call) stack underflow!!!");
                         hardfault();
                         return;
                     }
@@ -95,7 +426,7 @@ void mpu::chip8::clock(void)
                     // sys call
                     // currently no sys-call mappings
                     // hardfault on invalid instruction!
-                    debug::trace("!!!chip8::clock unknown instruction range 0x0NNN!!!");
+                    TRACE_ERROR("!!!chip8::clock unknown instruction {x} in range 0x0NNN!!!", op);
                     hardfault();
                     return;
                     break;
@@ -109,14 +440,16 @@ void mpu::chip8::clock(void)
 
         case 0x2000:
             // call to "NNN"
-            // push this to the stack
+            // push this to the stack, 00EE returns past it
             stack[sp++] = pc;
             if (sp >= sizeof(stack)/sizeof(*stack))
             {
-                debug::trace("!!!chip8::clock (call) stack overflow!!!");
+                TRACE_ERROR("!!!chip8::clock (call) stack overflow!!!");
                 hardfault();
                 return;
             }
+            pc = op & 0x0FFF;
+            return;
             break;
 
         case 0x3000:
@@ -151,7 +484,7 @@ void mpu::chip8::clock(void)
             if (op & 0x000F)
             {
                 // bad instruction!
-                debug::trace("!!!chip8::clock bad instruction 0x5nnX!!!");
+                TRACE_ERROR("!!!chip8::clock bad instruction {x} (0x5nnX)!!!", op);
                 hardfault();
                 return;
             }
@@ -212,7 +545,8 @@ void mpu::chip8::clock(void)
                 } break;
 
                 case 5://==N
-                    v[vF] = (v[x] > v[y]);
+                    // VF = no borrow
+                    v[vF] = (v[x] >= v[y]);
                     v[x] -= v[y];
                     break;
 
@@ -222,7 +556,7 @@ void mpu::chip8::clock(void)
                     break;
 
                 case 7://==N
-                    v[vF] = (v[y] > v[x]);
+                    v[vF] = (v[y] >= v[x]);
                     v[x] = v[y] - v[x];
                     break;
 
@@ -232,7 +566,7 @@ void mpu::chip8::clock(void)
                     break;
 
                 default:
-                    debug::trace("!!!chip8::clock badly formed instruction about M: 0x8xxM!!!");
+                    TRACE_ERROR("!!!chip8::clock badly formed instruction {x} about M: 0x8xxM!!!", op);
                     hardfault();
                     return;
             }
@@ -243,13 +577,13 @@ void mpu::chip8::clock(void)
             // 0x9xy0
             if (op & 0xF)
             {
-                debug::trace("!!!chip8::clock badly formed instruction about M: 0x9xxM!!!");
+                TRACE_WARN("!!!chip8::clock badly formed instruction {x} about M: 0x9xxM!!!", op);
             }
 
             uint16_t x = (op & 0x0F00) >> 8;
             uint16_t y = (op & 0x00F0) >> 4;
 
-            if (v[x] == v[y])
+            if (v[x] != v[y])
             {
                 pc += 2; // skip next instruction
             }
@@ -261,18 +595,20 @@ void mpu::chip8::clock(void)
 
         case 0xB000:
             pc = v[v0] + (op & 0x0FFF);
+            return;
             break;
 
         case 0xC000:
         {
             uint16_t x  = (op & 0x0F00) >> 8;
             uint16_t NN = op & 0x00FF;
-            v[x] = (rand() & NN);
+            v[x] = (random() & NN);
         } break;
 
         case 0xD000:
             // 0xDxyN
             // draw(vx, vy, N)
+            draw((op & 0x0F00) >> 8, (op & 0x00F0) >> 4, op & 0x000F);
             break;
 
         case 0xE000:
@@ -280,16 +616,25 @@ void mpu::chip8::clock(void)
             {
                 uint16_t x = (op & 0x0F00) >> 8;
                 // if key( v[x] ) is pressed, skip
+                if (keys & (1u << (v[x] & 0xF)))
+                {
+                    pc += 2;
+                }
             }
             else if ((op & 0xF0FF) == 0xE0A1)
             {
                 uint16_t x = (op & 0x0F00) >> 8;
                 // if key( v[x] ) is released, skip
+                if ((keys & (1u << (v[x] & 0xF))) == 0)
+                {
+                    pc += 2;
+                }
             }
             else
             {
-                debug::trace("!!!chip8::clock bad instruction!!!");
+                TRACE_ERROR("!!!chip8::clock bad instruction {x}!!!", op);
                 hardfault();
+                return;
             }
             break;
 
@@ -300,18 +645,38 @@ void mpu::chip8::clock(void)
             {
                 case 0xF007:
                     // Vx = get_delay()
+                    v[x] = delay;
                     break;
 
                 case 0xF00A:
                     // Vx = get_key() (blocking)
+                    if (wait_key(x) == false)
+                    {
+                        return;
+                    }
                     break;
 
                 case 0xF015:
                     // delay_timer(Vx)
+                    delay = v[x];
                     break;
 
                 case 0xF018:
                     // sound_timer(Vx)
+                    sound = v[x];
+                    break;
+
+                case 0xF002:
+                    // audio_pattern(I[0:15]), XO-CHIP
+                    for (uint32_t j = 0; j < audio_state::pattern_size; ++j)
+                    {
+                        audio.pattern[j] = mem[(i + j) & address_mask];
+                    }
+                    break;
+
+                case 0xF03A:
+                    // pitch(Vx), XO-CHIP
+                    audio.pitch = v[x];
                     break;
 
                 case 0xF01E:
@@ -321,6 +686,7 @@ void mpu::chip8::clock(void)
 
                 case 0xF029:
                     // I = sprite_addr[Vx]
+                    i = font_start + (v[x] & 0xF) * 5;
                     break;
 
                 case 0xF033:
@@ -329,9 +695,9 @@ void mpu::chip8::clock(void)
                     // I[1] = BCD(2);     (10s)
                     // I[2] = BCD(1); LSB (1s)
                     // take BCD rep of Vx, place into I[...]
-                    mem[i] = v[x] / 100;
-                    mem[i + 1] = (v[x] - mem[i]) / 10;
-                    mem[i + 2] = v[x] - mem[i + 1]*10 - mem[i]*100;
+                    store(i & address_mask, v[x] / 100);
+                    store((i + 1) & address_mask, (v[x] / 10) % 10);
+                    store((i + 2) & address_mask, v[x] % 10);
                     break;
 
                 case 0xF055:
@@ -339,14 +705,14 @@ void mpu::chip8::clock(void)
                     // otherwise known as push registers to location in I (I is not modified)
                     if (i + x > 0xFFF)
                     {
-                        debug::trace("!!!chip8::clock overflow in I at 0xFx55!!!");
+                        TRACE_ERROR("!!!chip8::clock overflow in I ({x}) at 0xFx55!!!", i);
                         hardfault();
                         return;
                     }
 
-                    for (uint32_t j = 0; j < x; ++j)
+                    for (uint32_t j = 0; j <= x; ++j)
                     {
-                        mem[i + j] = v[j];
+                        store(i + j, v[j]);
                     }
                     break;
 
@@ -355,19 +721,19 @@ void mpu::chip8::clock(void)
                     // otherwise known as pop registers from location in I (I is not modified)
                     if (i + x > 0xFFF)
                     {
-                        debug::trace("!!!chip8::clock overflow in I at 0xFx65!!!");
+                        TRACE_ERROR("!!!chip8::clock overflow in I ({x}) at 0xFx65!!!", i);
                         hardfault();
                         return;
                     }
 
-                    for (uint32_t j = 0; j < x; ++j)
+                    for (uint32_t j = 0; j <= x; ++j)
                     {
                         v[j] = mem[i + j];
                     }
                     break;
 
                 default:
-                    debug::trace("!!!chip8::clock bad instruction around 0xFxMM!!!");
+                    TRACE_ERROR("!!!chip8::clock bad instruction {x} around 0xFxMM!!!", op);
                     hardfault();
                     return;
                     break;
@@ -375,7 +741,7 @@ void mpu::chip8::clock(void)
         } break;
 
         default:
-            debug::trace("!!!chip8::clock bad instruction!!!");
+            TRACE_ERROR("!!!chip8::clock bad instruction {x}!!!", op);
             hardfault();
             return;
             break;
@@ -26,9 +26,49 @@
 
 namespace mpu
 {
+    class chip8;
+
+    // monochrome 64x32 display, one packed row per uint64_t
+    struct framebuffer
+    {
+        const static uint32_t width = 64u;
+        const static uint32_t height = 32u;
+
+        uint64_t rows[height]; // bit 63 is x = 0
+
+        bool pixel(uint32_t x, uint32_t y) const { return (rows[y] >> (63u - x)) & 1u; }
+    };
+
     struct display_hook
     {
         virtual void clear_screen(void) = 0;
+        // called once per emulated frame with the completed framebuffer
+        virtual void vblank(framebuffer const& fb) = 0;
+    };
+
+    // XO-CHIP style 1-bit sample pattern, played back at
+    // 4000 * 2^((pitch - 64) / 48) bits per second while the sound timer runs
+    struct audio_state
+    {
+        const static uint32_t pattern_size  = 16u;
+        const static uint8_t  default_pitch = 64u;
+
+        uint8_t pattern[pattern_size]; // bit 7 of byte 0 plays first
+        uint8_t pitch;
+    };
+
+    struct audio_hook
+    {
+        // called once per emulated frame, before the timers tick
+        virtual void frame(bool active, audio_state const& audio) = 0;
+    };
+
+    struct debug_hook
+    {
+        // a marked address is about to execute, return true to stop before it
+        virtual bool breakpoint(chip8 const& cpu, uint16_t pc) = 0;
+        // an instruction wrote a watched byte, return true to stop after it
+        virtual bool watchpoint(chip8 const& cpu, uint16_t address, uint8_t value) = 0;
     };
 
     struct input_hook
@@ -44,10 +84,48 @@ namespace mpu
         virtual void get_keystate(key code) = 0;
     };
 
+    struct trace_hook
+    {
+        // called after every executed instruction with the pc and opcode it was fetched from
+        virtual void retire(chip8 const& cpu, uint16_t pc, uint16_t op) = 0;
+    };
+
+    // instruction pre-decoded by operand, one per memory address
+    struct decoded_op
+    {
+        uint8_t  handler; // chip8::handler
+        uint8_t  x;
+        uint8_t  y;
+        uint8_t  n;
+        uint16_t nnn;     // low byte doubles as NN
+    };
+
     struct hardware_hooks
     {
-        display_hook* pDisplay;
-        input_hook* pInput;
+        display_hook* pDisplay = nullptr;
+        input_hook* pInput = nullptr;
+        trace_hook* pTrace = nullptr;
+        audio_hook* pAudio = nullptr;
+        debug_hook* pDebug = nullptr;
+    };
+
+    // addresses of an instance's live state, valid as long as the instance
+    // exists and always current, reading through them copies nothing
+    struct state_view
+    {
+        uint8_t const  *v;      // V0..VF
+        uint16_t const *i;
+        uint16_t const *pc;
+        uint16_t const *sp;
+        uint16_t const *stack;  // stack_depth entries
+        uint8_t const  *delay;
+        uint8_t const  *sound;
+        uint16_t const *keys;
+        uint64_t const *cycles;
+        uint64_t const *frames;
+        uint32_t const *faults;
+        uint8_t const  *memory; // memory_size bytes
+        uint64_t const *rows;   // framebuffer::height packed rows
     };
 
     class chip8
@@ -55,6 +133,12 @@ namespace mpu
         public:
             const static uint32_t memory_size = 4096u;
             const static uint32_t stack_depth = 16;
+            const static uint32_t address_mask = memory_size - 1;
+            const static uint32_t program_start = 0x200u;
+            const static uint32_t font_start = 0x050u;
+            const static uint32_t num_keys = 16u;
+            const static uint32_t default_frame_instructions = 10u; // ~600Hz at 60 frames/s
+            const static uint32_t default_seed = 0x2545F491u;
             enum reg
             {
                 v0 = 0,
@@ -67,9 +151,61 @@ namespace mpu
             chip8(hardware_hooks const& hooks);
 
             void init(void);
+            void seed(uint32_t value);
+            void load(uint16_t address, uint8_t const *data, uint32_t size);
+            // reset and copy a program to program_start, code optionally holds
+            // its instructions already decoded (one decode(op) per byte)
+            void boot(uint8_t const *program, uint32_t size, decoded_op const *code = nullptr);
+
+            // reference interpreter, fetch/decode/execute one instruction
             void clock(void);
+            // pre-decoded engine, executes count instructions, returns how
+            // many were left when a breakpoint or watchpoint stopped it
+            uint32_t run(uint32_t count);
+            // one 60Hz frame: run instructions, tick timers, present the display.
+            // returns false if stopped, the next call finishes the same frame
+            bool frame(uint32_t instructions);
+            // the next instruction of the current frame, true if it ended the frame
+            bool step(uint32_t instructions);
             void hardfault(void);
 
+            // breakpoints replace the instruction in the decoded stream and
+            // watchpoints are only looked at when an instruction stores to
+            // memory, neither costs anything while none are set. pDebug
+            // decides whether a hit actually stops.
+            void set_breakpoint(uint16_t address, bool enabled);
+            bool get_breakpoint(uint16_t address) const { return test(breakpoints, address); }
+            void set_watchpoint(uint16_t address, bool enabled);
+            bool get_watchpoint(uint16_t address) const { return test(watchpoints, address); }
+            // execute the instruction at pc on the next run instead of stopping on it again.
+            // only a marked pc is remembered, an unmarked one would swallow a later stop there
+            void resume(void)
+            {
+                uint16_t const at = pc & address_mask;
+                resumeAt = code[at].handler == op_breakpoint ? at : no_address;
+            }
+
+            static decoded_op decode(uint16_t op);
+
+            void set_key(uint8_t key, bool pressed);
+            void set_keys(uint16_t mask) { keys = mask; }
+
+            uint8_t  get_register(reg index) const { return v[index]; }
+            uint16_t get_i(void) const             { return i; }
+            uint16_t get_pc(void) const            { return pc; }
+            uint16_t get_sp(void) const            { return sp; }
+            uint16_t get_stack(uint32_t level) const { return stack[level]; }
+            uint64_t get_cycles(void) const        { return cycles; }
+            uint32_t get_faults(void) const        { return faults; }
+            uint64_t get_frames(void) const        { return frames; }
+            uint8_t  get_delay(void) const         { return delay; }
+            uint8_t  get_sound(void) const         { return sound; }
+            uint16_t get_keys(void) const          { return keys; }
+            audio_state const& get_audio(void) const { return audio; }
+            uint8_t const* memory(void) const      { return mem; }
+            framebuffer const& display(void) const { return fb; }
+            state_view view(void) const;
+
         private:
             uint8_t  mem[memory_size];
             uint8_t  v[reg::num];
@@ -77,7 +213,85 @@ namespace mpu
             uint16_t pc;
             uint16_t stack[stack_depth];
             uint16_t sp;
+            uint64_t cycles;
+            uint32_t faults;
+            uint64_t frames;
+            uint8_t  delay;
+            uint8_t  sound;
+            uint16_t keys;
+            framebuffer fb;
+            audio_state audio;
+            uint32_t rngSeed;
+            uint32_t rng;
+            uint32_t frameLeft; // instructions of an interrupted frame
             hardware_hooks hooks;
+            decoded_op code[memory_size];
+
+            const static uint16_t no_address = 0xFFFF;
+            uint64_t breakpoints[memory_size / 64];
+            uint64_t watchpoints[memory_size / 64];
+            uint32_t breakpointCount;
+            uint32_t watchpointCount;
+            uint16_t resumeAt;
+            uint16_t armedAt;   // one-shot stop after a watchpoint hit
+
+            enum handler : uint8_t
+            {
+                op_invalid = 0,
+                op_nop,
+                op_cls,
+                op_ret,
+                op_jp,
+                op_call,
+                op_se_imm,
+                op_sne_imm,
+                op_se_reg,
+                op_ld_imm,
+                op_add_imm,
+                op_ld_reg,
+                op_or,
+                op_and,
+                op_xor,
+                op_add_reg,
+                op_sub,
+                op_shr,
+                op_subn,
+                op_shl,
+                op_sne_reg,
+                op_ld_i,
+                op_jp_v0,
+                op_rnd,
+                op_drw,
+                op_skp,
+                op_sknp,
+                op_ld_vx_dt,
+                op_ld_vx_k,
+                op_ld_dt_vx,
+                op_ld_st_vx,
+                op_audio,
+                op_pitch,
+                op_breakpoint, // marker, the real instruction is decoded again on pass
+                op_add_i,
+                op_ld_f,
+                op_ld_b,
+                op_ld_mem_regs,
+                op_ld_regs_mem,
+            };
+
+            void execute(uint16_t op);
+            uint8_t random(void);
+            void draw(uint8_t x, uint8_t y, uint8_t n);
+            bool wait_key(uint8_t x);
+            void write_memory(uint16_t address, uint8_t value);
+            void store(uint16_t address, uint8_t value);
+            void predecode(uint16_t address);
+            bool advance(uint32_t instructions, uint32_t limit);
+            bool break_here(void);
+
+            static bool test(uint64_t const *bits, uint16_t address)
+            {
+                return (bits[(address & address_mask) >> 6] >> (address & 63)) & 1;
+            }
     };
 }
 
@@ -0,0 +1,248 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// chip8_debug_test: breakpoints, watchpoints, resume and step on the
+// decoded and the tracing path, run by ctest
+
+#include "chip8.h"
+#include "debugger.h"
+
+#include <cstdio>
+#include <initializer_list>
+#include <vector>
+
+namespace
+{
+    int s_failures = 0;
+
+    #define CHECK(expr)                                                          \
+        do                                                                       \
+        {                                                                        \
+            if (!(expr))                                                         \
+            {                                                                    \
+                printf("%s: %s:%d: check failed: %s\n", engine, __FILE__, __LINE__, #expr); \
+                ++s_failures;                                                    \
+            }                                                                    \
+        } while (0)
+
+    struct counting_trace : mpu::trace_hook
+    {
+        uint64_t retired = 0;
+        void retire(mpu::chip8 const&, uint16_t, uint16_t) override { ++retired; }
+    };
+
+    // stops on every hit unless a register condition is set
+    struct recording_debug : mpu::debug_hook
+    {
+        int      stopWhenV0 = -1;
+        uint32_t breaks = 0;
+        std::vector<uint8_t> written;
+
+        bool breakpoint(mpu::chip8 const& cpu, uint16_t) override
+        {
+            ++breaks;
+            return stopWhenV0 < 0 || cpu.get_register(mpu::chip8::v0) == stopWhenV0;
+        }
+
+        bool watchpoint(mpu::chip8 const&, uint16_t, uint8_t value) override
+        {
+            written.push_back(value);
+            return true;
+        }
+    };
+
+    struct machine
+    {
+        counting_trace  trace;
+        recording_debug debug;
+        mpu::chip8      cpu;
+
+        machine(std::initializer_list<uint16_t> ops, bool tracing) :
+            cpu(hooks(tracing))
+        {
+            std::vector<uint8_t> program;
+            for (uint16_t op : ops)
+            {
+                program.push_back(op >> 8);
+                program.push_back(op & 0xFF);
+            }
+            cpu.boot(program.data(), program.size());
+        }
+
+        mpu::hardware_hooks hooks(bool tracing)
+        {
+            mpu::hardware_hooks result;
+            result.pTrace = tracing ? &trace : nullptr;
+            result.pDebug = &debug;
+            return result;
+        }
+
+        uint8_t v0(void) const { return cpu.get_register(mpu::chip8::v0); }
+    };
+
+    void test_engine(bool tracing)
+    {
+        char const *engine = tracing ? "trace" : "decoded";
+
+        {
+            // 6000 7001 1202: a breakpoint stops before the marked instruction,
+            // resume runs it and the same frame carries on
+            machine m({ 0x6000, 0x7001, 0x1202 }, tracing);
+            m.cpu.set_breakpoint(0x202, true);
+            CHECK(m.cpu.frame(10) == false);
+            CHECK(m.cpu.get_pc() == 0x202);
+            CHECK(m.cpu.get_cycles() == 1);
+            CHECK(m.cpu.get_frames() == 0);
+
+            m.cpu.resume();
+            CHECK(m.cpu.frame(10) == false);
+            CHECK(m.cpu.get_cycles() == 3);
+            CHECK(m.v0() == 1);
+
+            // without breakpoints the interrupted frame finishes at 10 instructions
+            m.cpu.set_breakpoint(0x202, false);
+            m.cpu.resume();
+            CHECK(m.cpu.frame(10) == true);
+            CHECK(m.cpu.get_cycles() == 10);
+            CHECK(m.cpu.get_frames() == 1);
+            CHECK(m.debug.breaks == 2);
+            if (tracing)
+            {
+                CHECK(m.trace.retired == 10);
+            }
+        }
+        {
+            // the hook decides, passing a marker executes the real instruction
+            machine m({ 0x6000, 0x7001, 0x1202 }, tracing);
+            m.debug.stopWhenV0 = 5;
+            m.cpu.set_breakpoint(0x202, true);
+            CHECK(m.cpu.frame(100) == false);
+            CHECK(m.v0() == 5);
+            CHECK(m.cpu.get_pc() == 0x202);
+            CHECK(m.debug.breaks == 6);
+        }
+        {
+            // breakpoints set before boot survive the pre-decoded image copy
+            mpu::hardware_hooks none;
+            recording_debug debug;
+            none.pDebug = &debug;
+            mpu::chip8 cpu(none);
+            cpu.set_breakpoint(0x204, true);
+            static uint8_t const program[] = { 0x60, 0x00, 0x70, 0x01, 0x12, 0x02 };
+            cpu.boot(program, sizeof(program));
+            CHECK(cpu.frame(10) == false);
+            CHECK(cpu.get_pc() == 0x204);
+        }
+        {
+            // 6000 7001 A300 F055 1202: every store to 300 stops after FX55,
+            // continuing never skips the next hit
+            machine m({ 0x6000, 0x7001, 0xA300, 0xF055, 0x1202 }, tracing);
+            m.cpu.set_watchpoint(0x300, true);
+            for (uint8_t expected = 1; expected <= 4; ++expected)
+            {
+                CHECK(m.cpu.frame(100) == false);
+                CHECK(m.cpu.get_pc() == 0x208);
+                CHECK(m.cpu.memory()[0x300] == expected);
+                m.cpu.resume();
+            }
+            CHECK((m.debug.written == std::vector<uint8_t>{ 1, 2, 3, 4 }));
+
+            m.cpu.set_watchpoint(0x300, false);
+            CHECK(m.cpu.frame(100) == true);
+        }
+        {
+            // step() runs one instruction of the frame and ends it on the last one
+            machine m({ 0x6000, 0x7001, 0x1202 }, tracing);
+            for (uint32_t n = 1; n < 10; ++n)
+            {
+                CHECK(m.cpu.step(10) == false);
+                CHECK(m.cpu.get_cycles() == n);
+            }
+            CHECK(m.cpu.step(10) == true);
+            CHECK(m.cpu.get_frames() == 1);
+
+            // stepping onto a breakpoint stops, resume steps over it
+            m.cpu.set_breakpoint(m.cpu.get_pc(), true);
+            CHECK(m.cpu.step(10) == false);
+            CHECK(m.cpu.get_cycles() == 10);
+            m.cpu.resume();
+            CHECK(m.cpu.step(10) == false);
+            CHECK(m.cpu.get_cycles() == 11);
+        }
+        {
+            // debugger conditions on V registers and I
+            machine m({ 0x6000, 0x7001, 0x1202 }, tracing);
+            debug::debugger debugger;
+            mpu::hardware_hooks hooks;
+            hooks.pTrace = tracing ? &m.trace : nullptr;
+            hooks.pDebug = &debugger;
+            mpu::chip8 cpu(hooks);
+            static uint8_t const program[] = { 0x60, 0x00, 0x70, 0x01, 0xA0, 0x00, 0xF0, 0x1E, 0x12, 0x02 };
+            cpu.boot(program, sizeof(program));
+
+            debug::debugger::condition when;
+            when.reg = 0;
+            when.op = debug::debugger::greater_equal;
+            when.value = 3;
+            debugger.add_breakpoint(cpu, 0x206, when);
+            CHECK(cpu.frame(100) == false);
+            CHECK(cpu.get_register(mpu::chip8::v0) == 3);
+            CHECK(debugger.reason() == "breakpoint at 206 if V0 >= 3");
+
+            debugger.remove_breakpoint(cpu, 0x206);
+            when.reg = debug::debugger::condition::reg_i;
+            when.op = debug::debugger::equal;
+            when.value = 5;
+            debugger.add_breakpoint(cpu, 0x208, when);
+            cpu.resume();
+            CHECK(cpu.frame(100) == false);
+            CHECK(cpu.get_i() == 5);
+            CHECK(cpu.get_register(mpu::chip8::v0) == 5);
+        }
+    }
+
+    void test_disassembly(void)
+    {
+        char const *engine = "disassemble";
+        CHECK(debug::debugger::disassemble(0x00E0) == "CLS");
+        CHECK(debug::debugger::disassemble(0x2ABC) == "CALL ABC");
+        CHECK(debug::debugger::disassemble(0x8AB4) == "ADD VA, VB");
+        CHECK(debug::debugger::disassemble(0xD125) == "DRW V1, V2, 5");
+        CHECK(debug::debugger::disassemble(0xF33A) == "PITCH V3");
+        CHECK(debug::debugger::disassemble(0x8AB9) == "DW 8AB9");
+    }
+}
+
+int main(void)
+{
+    test_engine(false);
+    test_engine(true);
+    test_disassembly();
+
+    if (s_failures)
+    {
+        printf("chip8_debug_test: %d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("chip8_debug_test passed\n");
+    return 0;
+}
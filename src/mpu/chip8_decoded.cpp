@@ -0,0 +1,365 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "chip8.h"
+
+#include "debug.h"
+
+#include <cstring>
+
+// pre-decoded engine
+//
+// every memory address carries its instruction split into handler and
+// operands, refreshed whenever memory is written. run() dispatches on the
+// handler directly instead of re-decoding the opcode every cycle.
+// semantics must match chip8::clock exactly, chip8_fuzz checks the two
+// engines against each other.
+
+mpu::decoded_op mpu::chip8::decode(uint16_t op)
+{
+    decoded_op d;
+    d.handler = op_invalid;
+    d.x       = (op & 0x0F00) >> 8u;
+    d.y       = (op & 0x00F0) >> 4u;
+    d.n       = (op & 0x000F);
+    d.nnn     = (op & 0x0FFF);
+
+    switch (op & 0xF000)
+    {
+        case 0x0000:
+            switch (op)
+            {
+                case 0x0000: d.handler = op_nop; break;
+                case 0x00E0: d.handler = op_cls; break;
+                case 0x00EE: d.handler = op_ret; break;
+            }
+            break;
+
+        case 0x1000: d.handler = op_jp;      break;
+        case 0x2000: d.handler = op_call;    break;
+        case 0x3000: d.handler = op_se_imm;  break;
+        case 0x4000: d.handler = op_sne_imm; break;
+
+        case 0x5000:
+            if (d.n == 0)
+            {
+                d.handler = op_se_reg;
+            }
+            break;
+
+        case 0x6000: d.handler = op_ld_imm;  break;
+        case 0x7000: d.handler = op_add_imm; break;
+
+        case 0x8000:
+            switch (d.n)
+            {
+                case 0x0: d.handler = op_ld_reg;  break;
+                case 0x1: d.handler = op_or;      break;
+                case 0x2: d.handler = op_and;     break;
+                case 0x3: d.handler = op_xor;     break;
+                case 0x4: d.handler = op_add_reg; break;
+                case 0x5: d.handler = op_sub;     break;
+                case 0x6: d.handler = op_shr;     break;
+                case 0x7: d.handler = op_subn;    break;
+                case 0xE: d.handler = op_shl;     break;
+            }
+            break;
+
+        case 0x9000: d.handler = op_sne_reg; break;
+        case 0xA000: d.handler = op_ld_i;    break;
+        case 0xB000: d.handler = op_jp_v0;   break;
+        case 0xC000: d.handler = op_rnd;     break;
+        case 0xD000: d.handler = op_drw;     break;
+
+        case 0xE000:
+            switch (op & 0x00FF)
+            {
+                case 0x9E: d.handler = op_skp;  break;
+                case 0xA1: d.handler = op_sknp; break;
+            }
+            break;
+
+        case 0xF000:
+            switch (op & 0x00FF)
+            {
+                case 0x07: d.handler = op_ld_vx_dt;    break;
+                case 0x0A: d.handler = op_ld_vx_k;     break;
+                case 0x15: d.handler = op_ld_dt_vx;    break;
+                case 0x18: d.handler = op_ld_st_vx;    break;
+                case 0x02: d.handler = op_audio;       break;
+                case 0x3A: d.handler = op_pitch;       break;
+                case 0x1E: d.handler = op_add_i;       break;
+                case 0x29: d.handler = op_ld_f;        break;
+                case 0x33: d.handler = op_ld_b;        break;
+                case 0x55: d.handler = op_ld_mem_regs; break;
+                case 0x65: d.handler = op_ld_regs_mem; break;
+            }
+            break;
+    }
+
+    return d;
+}
+
+uint32_t mpu::chip8::run(uint32_t count)
+{
+    if (hooks.pTrace)
+    {
+        // tracing needs the per-instruction hook, use the reference path
+        for (; count; --count)
+        {
+            pc &= address_mask;
+            if (code[pc].handler == op_breakpoint && break_here())
+            {
+                return count;
+            }
+            clock();
+        }
+        return 0;
+    }
+
+    for (; count; --count)
+    {
+        pc &= address_mask;
+        ++cycles;
+
+        decoded_op d = code[pc];
+    dispatch:
+        switch (d.handler)
+        {
+            case op_nop:
+                break;
+
+            case op_cls:
+                memset(&fb, 0, sizeof(fb));
+                if (hooks.pDisplay)
+                {
+                    hooks.pDisplay->clear_screen();
+                }
+                break;
+
+            case op_ret:
+                if (sp == 0)
+                {
+                    TRACE_ERROR("!!!chip8::run (call) stack underflow!!!");
+                    hardfault();
+                    continue;
+                }
+                pc = stack[--sp];
+                break;
+
+            case op_jp:
+                pc = d.nnn;
+                continue;
+
+            case op_call:
+                stack[sp++] = pc;
+                if (sp >= stack_depth)
+                {
+                    TRACE_ERROR("!!!chip8::run (call) stack overflow!!!");
+                    hardfault();
+                    continue;
+                }
+                pc = d.nnn;
+                continue;
+
+            case op_se_imm:
+                if (v[d.x] == (d.nnn & 0xFF)) pc += 2u;
+                break;
+
+            case op_sne_imm:
+                if (v[d.x] != (d.nnn & 0xFF)) pc += 2u;
+                break;
+
+            case op_se_reg:
+                if (v[d.x] == v[d.y]) pc += 2u;
+                break;
+
+            case op_ld_imm:
+                v[d.x] = d.nnn & 0xFF;
+                break;
+
+            case op_add_imm:
+                v[d.x] += d.nnn & 0xFF;
+                break;
+
+            case op_ld_reg:
+                v[d.x] = v[d.y];
+                break;
+
+            case op_or:
+                v[d.x] |= v[d.y];
+                break;
+
+            case op_and:
+                v[d.x] &= v[d.y];
+                break;
+
+            case op_xor:
+                v[d.x] ^= v[d.y];
+                break;
+
+            case op_add_reg:
+            {
+                uint16_t result = v[d.x] + v[d.y];
+                v[vF] = (result > 0xFF);
+                v[d.x] = result & 0xFF;
+            } break;
+
+            case op_sub:
+                v[vF] = (v[d.x] >= v[d.y]);
+                v[d.x] -= v[d.y];
+                break;
+
+            case op_shr:
+                v[vF] = v[d.x] & 0x1;
+                v[d.x] >>= 1;
+                break;
+
+            case op_subn:
+                v[vF] = (v[d.y] >= v[d.x]);
+                v[d.x] = v[d.y] - v[d.x];
+                break;
+
+            case op_shl:
+                v[vF] = (v[d.x] & 0x80) >> 7u;
+                v[d.x] <<= 1;
+                break;
+
+            case op_sne_reg:
+                if (v[d.x] != v[d.y]) pc += 2u;
+                break;
+
+            case op_ld_i:
+                i = d.nnn;
+                break;
+
+            case op_jp_v0:
+                pc = v[v0] + d.nnn;
+                continue;
+
+            case op_rnd:
+                v[d.x] = random() & d.nnn & 0xFF;
+                break;
+
+            case op_drw:
+                draw(d.x, d.y, d.n);
+                break;
+
+            case op_skp:
+                if (keys & (1u << (v[d.x] & 0xF))) pc += 2u;
+                break;
+
+            case op_sknp:
+                if ((keys & (1u << (v[d.x] & 0xF))) == 0) pc += 2u;
+                break;
+
+            case op_ld_vx_dt:
+                v[d.x] = delay;
+                break;
+
+            case op_ld_vx_k:
+                if (wait_key(d.x) == false)
+                {
+                    continue;
+                }
+                break;
+
+            case op_ld_dt_vx:
+                delay = v[d.x];
+                break;
+
+            case op_ld_st_vx:
+                sound = v[d.x];
+                break;
+
+            case op_audio:
+                for (uint32_t j = 0; j < audio_state::pattern_size; ++j)
+                {
+                    audio.pattern[j] = mem[(i + j) & address_mask];
+                }
+                break;
+
+            case op_pitch:
+                audio.pitch = v[d.x];
+                break;
+
+            case op_ld_f:
+                i = font_start + (v[d.x] & 0xF) * 5;
+                break;
+
+            case op_add_i:
+                i += v[d.x];
+                break;
+
+            case op_ld_b:
+                store(i & address_mask, v[d.x] / 100);
+                store((i + 1) & address_mask, (v[d.x] / 10) % 10);
+                store((i + 2) & address_mask, v[d.x] % 10);
+                break;
+
+            case op_ld_mem_regs:
+                if (i + d.x > 0xFFF)
+                {
+                    TRACE_ERROR("!!!chip8::run overflow in I ({x}) at 0xFx55!!!", i);
+                    hardfault();
+                    continue;
+                }
+                for (uint32_t j = 0; j <= d.x; ++j)
+                {
+                    store(i + j, v[j]);
+                }
+                break;
+
+            case op_ld_regs_mem:
+                if (i + d.x > 0xFFF)
+                {
+                    TRACE_ERROR("!!!chip8::run overflow in I ({x}) at 0xFx65!!!", i);
+                    hardfault();
+                    continue;
+                }
+                for (uint32_t j = 0; j <= d.x; ++j)
+                {
+                    v[j] = mem[i + j];
+                }
+                break;
+
+            case op_breakpoint:
+                if (break_here())
+                {
+                    --cycles;
+                    return count;
+                }
+                // not stopping, run the instruction the marker stands in for
+                d = decode((mem[pc] << 8u) | mem[(pc + 1) & address_mask]);
+                goto dispatch;
+
+            case op_invalid:
+            default:
+                TRACE_ERROR("!!!chip8::run bad instruction {x}!!!",
+                            (mem[pc] << 8u) | mem[(pc + 1) & address_mask]);
+                hardfault();
+                continue;
+        }
+
+        pc += 2u;
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// chip8_isa_test: instruction semantics, run on both engines by ctest
+
+#include "chip8.h"
+
+#include <cstdio>
+#include <initializer_list>
+#include <vector>
+
+namespace
+{
+    int s_failures = 0;
+
+    #define CHECK(expr)                                                          \
+        do                                                                       \
+        {                                                                        \
+            if (!(expr))                                                         \
+            {                                                                    \
+                printf("%s: %s:%d: check failed: %s\n", engine, __FILE__, __LINE__, #expr); \
+                ++s_failures;                                                    \
+            }                                                                    \
+        } while (0)
+
+    // boots ops at program_start and executes count instructions on one engine
+    struct machine
+    {
+        mpu::chip8 cpu;
+
+        machine(std::initializer_list<uint16_t> ops, uint32_t count, bool decoded) :
+            cpu(mpu::hardware_hooks())
+        {
+            std::vector<uint8_t> program;
+            for (uint16_t op : ops)
+            {
+                program.push_back(op >> 8);
+                program.push_back(op & 0xFF);
+            }
+            cpu.boot(program.data(), program.size());
+            if (decoded)
+            {
+                cpu.run(count);
+            }
+            else
+            {
+                while (count--)
+                {
+                    cpu.clock();
+                }
+            }
+        }
+
+        uint8_t v(uint32_t index) const { return cpu.get_register(static_cast<mpu::chip8::reg>(index)); }
+    };
+
+    void test_engine(bool decoded)
+    {
+        char const *engine = decoded ? "run" : "clock";
+
+        {
+            // programs start at 0x200, the font lives at 0x050
+            machine m({ 0x0000 }, 0, decoded);
+            CHECK(m.cpu.get_pc() == mpu::chip8::program_start);
+            CHECK(m.cpu.memory()[mpu::chip8::font_start] == 0xF0);
+            CHECK(m.cpu.memory()[mpu::chip8::font_start + 5 * 16 - 1] == 0x80);
+        }
+        {
+            // 2NNN calls, 00EE returns past the call
+            machine m({ 0x2206, 0x0000, 0x0000, 0x00EE }, 1, decoded);
+            CHECK(m.cpu.get_pc() == 0x206);
+            CHECK(m.cpu.get_sp() == 1);
+            machine r({ 0x2206, 0x0000, 0x0000, 0x00EE }, 2, decoded);
+            CHECK(r.cpu.get_pc() == 0x202);
+            CHECK(r.cpu.get_sp() == 0);
+        }
+        {
+            // 9XY0 skips when not equal
+            machine m({ 0x6001, 0x6102, 0x9010 }, 3, decoded);
+            CHECK(m.cpu.get_pc() == 0x208);
+            machine e({ 0x6001, 0x6101, 0x9010 }, 3, decoded);
+            CHECK(e.cpu.get_pc() == 0x206);
+        }
+        {
+            // BNNN jumps to NNN + V0 without skipping
+            machine m({ 0x6004, 0xB300 }, 2, decoded);
+            CHECK(m.cpu.get_pc() == 0x304);
+        }
+        {
+            // FX55 / FX65 include Vx
+            machine m({ 0xA300, 0x6011, 0x6122, 0x6233, 0xF155, 0x6000, 0x6100, 0xF165 }, 8, decoded);
+            CHECK(m.cpu.memory()[0x300] == 0x11);
+            CHECK(m.cpu.memory()[0x301] == 0x22);
+            CHECK(m.cpu.memory()[0x302] == 0x00);
+            CHECK(m.v(0) == 0x11);
+            CHECK(m.v(1) == 0x22);
+        }
+        {
+            // 8XY5 / 8XY7 set VF on no borrow
+            machine sub({ 0x6005, 0x6103, 0x8015 }, 3, decoded);
+            CHECK(sub.v(0) == 0x02);
+            CHECK(sub.v(0xF) == 1);
+            machine borrow({ 0x6003, 0x6105, 0x8015 }, 3, decoded);
+            CHECK(borrow.v(0) == 0xFE);
+            CHECK(borrow.v(0xF) == 0);
+            machine subn({ 0x6003, 0x6105, 0x8017 }, 3, decoded);
+            CHECK(subn.v(0) == 0x02);
+            CHECK(subn.v(0xF) == 1);
+        }
+        {
+            // DXYN XORs the font sprite for 0 into the framebuffer, VF on collision
+            machine m({ 0x6000, 0xF029, 0x6105, 0x6203, 0xD125 }, 5, decoded);
+            CHECK(m.cpu.display().rows[3] == (0xF0ull << (63 - 5 - 7)));
+            CHECK(m.cpu.display().pixel(5, 3));
+            CHECK(m.cpu.display().pixel(9, 3) == false);
+            CHECK(m.v(0xF) == 0);
+            machine twice({ 0x6000, 0xF029, 0x6105, 0x6203, 0xD125, 0xD125 }, 6, decoded);
+            CHECK(twice.cpu.display().rows[3] == 0);
+            CHECK(twice.v(0xF) == 1);
+        }
+        {
+            // timers tick once per frame
+            machine m({ 0x6005, 0xF015, 0xF018, 0x120A, 0x0000, 0x120A }, 3, decoded);
+            CHECK(m.cpu.get_delay() == 5);
+            CHECK(m.cpu.get_sound() == 5);
+            m.cpu.frame(1);
+            CHECK(m.cpu.get_delay() == 4);
+            CHECK(m.cpu.get_sound() == 4);
+        }
+        {
+            // EX9E / EXA1 read the key state
+            machine m({ 0x6007 }, 1, decoded);
+            m.cpu.set_key(7, true);
+            m.cpu.load(0x202, reinterpret_cast<uint8_t const*>("\xE0\x9E"), 2);
+            if (decoded)
+            {
+                m.cpu.run(1);
+            }
+            else
+            {
+                m.cpu.clock();
+            }
+            CHECK(m.cpu.get_pc() == 0x206);
+        }
+    }
+}
+
+int main(void)
+{
+    test_engine(false);
+    test_engine(true);
+
+    if (s_failures)
+    {
+        printf("chip8_isa_test: %d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("chip8_isa_test passed\n");
+    return 0;
+}
@@ -0,0 +1,202 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "platform.h"
+#include "debug.h"
+
+#include "glfw3.h"
+
+#include <algorithm>
+
+// GLFW is initialized once per process and shared by every window
+static bool glfw_init_once(void)
+{
+    static bool s_initialized = (glfwInit() != 0);
+    return s_initialized;
+}
+
+platform::glfw_display::glfw_display() :
+    windowHandle(nullptr)
+{
+}
+
+platform::glfw_display::~glfw_display()
+{
+    if (windowHandle)
+    {
+        glfwDestroyWindow(static_cast<GLFWwindow*>(windowHandle));
+    }
+}
+
+bool platform::glfw_display::initialize(display_descriptor const &init)
+{
+    descriptor = init;
+
+    if (glfw_init_once() == false)
+    {
+        TRACE_ERROR("platform::glfw_display::initialize glfwInit() failed!");
+        return false;
+    }
+
+    windowHandle = static_cast<void*>(glfwCreateWindow(init.pixel_width(), 
+                                                       init.pixel_height(), 
+                                                       init.title.c_str(), 
+                                                       NULL, 
+                                                       NULL));
+    if (windowHandle == nullptr)
+    {
+        TRACE_ERROR("platform::glfw_display::initialize glfwCreateWindow() failed!");
+        return false;
+    }
+
+    glfwMakeContextCurrent(static_cast<GLFWwindow*>(windowHandle));
+
+    pixelBuffer.clear();
+    pixelBuffer.resize(init.width); // pixelBuffer[x][y]
+    for (auto& row : pixelBuffer) // for each row, add a column
+        row.resize(init.height, (rand() % 2) == 0 ? // randomly color each column
+                                    init.bg_color : init.fg_color);
+
+    pixelData.resize(init.pixel_width() * init.pixel_height());
+
+    TRACE_VERBOSE("platform::glfw_display::initialize completed.");
+    return true;
+}
+
+bool platform::glfw_display::ui_close(void) 
+{
+    return windowHandle == nullptr ||
+           glfwWindowShouldClose(static_cast<GLFWwindow *>(windowHandle));
+}
+
+void platform::glfw_display::update(void)
+{
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glMatrixMode( GL_PROJECTION );
+    glLoadIdentity();
+    glViewport(0, 0, descriptor.pixel_width(), descriptor.pixel_height());
+
+    for (int x = 0; x < descriptor.pixel_width(); ++x)
+    {
+        for (int y = 0; y < descriptor.pixel_height(); ++y)
+        {
+            pixelData[x + y * descriptor.pixel_width()] = pixelBuffer[x / descriptor.pixel_size][y / descriptor.pixel_size];
+        }
+    }
+
+    glDrawPixels(descriptor.pixel_width(),
+                 descriptor.pixel_height(),
+                 GL_RGB,
+                 GL_UNSIGNED_BYTE_3_3_2,
+                 pixelData.data());
+
+    glfwSwapBuffers(static_cast<GLFWwindow*>(windowHandle));
+
+    glfwPollEvents();
+}
+
+void platform::glfw_display::set_pixel(int32_t x, int32_t y)
+{
+    pixel(x, y, descriptor.fg_color);
+}
+
+void platform::glfw_display::clear_pixel(int32_t x, int32_t y)
+{
+    pixel(x, y, descriptor.bg_color);
+}
+
+void platform::glfw_display::pixel(int32_t x, int32_t y, uint8_t rgb)
+{
+    pixelBuffer[x][y] = rgb;
+}
+
+void platform::glfw_display::clear_screen(void)
+{
+    display::clear_screen();
+
+    for (int x = 0; x < descriptor.width; ++x)
+        for (int y = 0; y < descriptor.height; ++y)
+            pixelBuffer[x][y] = descriptor.bg_color;
+}
+
+void platform::glfw_display::vblank(mpu::framebuffer const& fb)
+{
+    display::vblank(fb);
+
+    int32_t const width  = std::min<int32_t>(descriptor.width,  mpu::framebuffer::width);
+    int32_t const height = std::min<int32_t>(descriptor.height, mpu::framebuffer::height);
+
+    for (int x = 0; x < width; ++x)
+        for (int y = 0; y < height; ++y)
+            pixelBuffer[x][y] = fb.pixel(x, y) ? descriptor.fg_color : descriptor.bg_color;
+}
+
+void platform::glfw_display::test_sanity(void)
+{
+    TRACE_INFO("platform::glfw_display::test_sanity begin");
+
+    TRACE_INFO("platform::glfw_display::test_sanity::test_window begin");
+    test_window();
+    TRACE_INFO("platform::glfw_display::test_sanity::test_window completed.");
+
+    TRACE_INFO("platform::glfw_display::test_sanity completed.");
+}
+
+void platform::glfw_display::test_window(void)
+{
+    // exercise a window through the shared GLFW instance instead of a
+    // separate glfwInit/glfwTerminate cycle
+    if (glfw_init_once() == false)
+    {
+        TRACE_ERROR("test_window -- glfwInit failed!");
+        return;
+    }
+
+    GLFWwindow* window = glfwCreateWindow(640, 480, "Hello World", NULL, NULL);
+    if (!window)
+    {
+        TRACE_ERROR("test_window -- glfwCreateWindow failed!");
+        return;
+    }
+
+    GLFWwindow* previous = static_cast<GLFWwindow*>(windowHandle);
+    glfwMakeContextCurrent(window);
+
+    /* Loop until the user closes the window */
+    for (int i = 0; i < 60 && !glfwWindowShouldClose(window); ++i)
+    {
+        /* Render here */
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        /* Swap front and back buffers */
+        glfwSwapBuffers(window);
+
+        /* Poll for and process events */
+        glfwPollEvents();
+    }
+
+    glfwDestroyWindow(window);
+    if (previous)
+    {
+        glfwMakeContextCurrent(previous);
+    }
+}
@@ -0,0 +1,159 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "platform.h"
+#include "png.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // 3 3 2 color to RGBA8, stored R G B A in memory
+    uint32_t to_rgba(float color)
+    {
+        uint8_t const c = static_cast<uint8_t>(color);
+        uint8_t const bytes[4] = { static_cast<uint8_t>(((c >> 5) & 7) * 255 / 7),
+                                   static_cast<uint8_t>(((c >> 2) & 7) * 255 / 7),
+                                   static_cast<uint8_t>((c & 3) * 255 / 3),
+                                   255 };
+        uint32_t rgba;
+        memcpy(&rgba, bytes, sizeof(rgba));
+        return rgba;
+    }
+
+    void fill(uint32_t *out, uint32_t color, int32_t count)
+    {
+#ifdef __SSE2__
+        __m128i const wide = _mm_set1_epi32(static_cast<int>(color));
+        for (; count >= 4; count -= 4, out += 4)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), wide);
+        }
+#endif
+        for (; count > 0; --count)
+        {
+            *out++ = color;
+        }
+    }
+}
+
+bool platform::offscreen_display::initialize(display_descriptor const &init)
+{
+    descriptor = init;
+    bg = to_rgba(init.bg_color);
+    fg = to_rgba(init.fg_color);
+
+    rgba.assign(static_cast<size_t>(init.pixel_width()) * init.pixel_height(), bg);
+    clear_screen();
+
+    TRACE_VERBOSE("platform::offscreen_display::initialize {} x {}", init.pixel_width(), init.pixel_height());
+    return true;
+}
+
+void platform::offscreen_display::update(void)
+{
+    int32_t const size   = descriptor.pixel_size;
+    int32_t const stride = descriptor.pixel_width();
+    int32_t const width  = std::min<int32_t>(descriptor.width,  mpu::framebuffer::width);
+    int32_t const height = std::min<int32_t>(descriptor.height, mpu::framebuffer::height);
+
+    // scale one native row into the first output row, then copy it down
+    for (int32_t y = 0; y < descriptor.height; ++y)
+    {
+        uint32_t *row = &rgba[static_cast<size_t>(y) * size * stride];
+        if (y < height)
+        {
+            uint64_t const bits = frame.rows[y];
+            for (int32_t x = 0; x < width; ++x)
+            {
+                fill(row + x * size, ((bits >> (63 - x)) & 1) ? fg : bg, size);
+            }
+            fill(row + width * size, bg, (descriptor.width - width) * size);
+        }
+        else
+        {
+            fill(row, bg, stride);
+        }
+
+        for (int32_t copy = 1; copy < size; ++copy)
+        {
+            memcpy(row + copy * stride, row, stride * sizeof(uint32_t));
+        }
+    }
+}
+
+bool platform::offscreen_display::screenshot(std::string const &path) const
+{
+    size_t const line = descriptor.pixel_width() * sizeof(uint32_t);
+
+    std::vector<uint8_t> raw;
+    raw.reserve((line + 1) * descriptor.pixel_height());
+    for (int32_t y = 0; y < descriptor.pixel_height(); ++y)
+    {
+        uint8_t const *row = reinterpret_cast<uint8_t const*>(&rgba[static_cast<size_t>(y) * descriptor.pixel_width()]);
+        raw.push_back(0);
+        raw.insert(raw.end(), row, row + line);
+    }
+
+    if (write_png(path, descriptor.pixel_width(), descriptor.pixel_height(), 8, png_rgba, raw) == false)
+    {
+        TRACE_ERROR("platform::offscreen_display::screenshot cannot write png");
+        return false;
+    }
+    return true;
+}
+
+void platform::offscreen_display::test_sanity(void)
+{
+    TRACE_INFO("platform::offscreen_display::test_sanity begin");
+
+    display::test_sanity();
+
+    mpu::framebuffer fb;
+    memset(&fb, 0, sizeof(fb));
+    fb.rows[1] = 1ull << 62; // x = 1, y = 1
+    vblank(fb);
+    update();
+
+    int32_t const size = descriptor.pixel_size;
+    for (int32_t y = 0; y < 2 * size; ++y)
+    {
+        for (int32_t x = 0; x < 2 * size; ++x)
+        {
+            bool const lit = (x >= size) && (y >= size);
+            if (rgba[static_cast<size_t>(y) * descriptor.pixel_width() + x] != (lit ? fg : bg))
+            {
+                TRACE_ERROR("platform::offscreen_display::test_sanity wrong pixel at {}, {}", x, y);
+                return;
+            }
+        }
+    }
+
+    clear_screen();
+    update();
+
+    TRACE_INFO("platform::offscreen_display::test_sanity completed.");
+}
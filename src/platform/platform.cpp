@@ -20,154 +20,75 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 #include "platform.h"
-#include "debug.h"
 
-#include "glfw3.h"
+#include <cstring>
 
-void platform::display::initialize(display_descriptor const &init)
+void platform::display::clear_screen(void)
 {
-    descriptor = init;
-
-    static bool s_initOnce = false;
-
-    if (s_initOnce == false)
-    {
-        if (!glfwInit())
-        {
-            debug::trace("platform::display::initialize glfwInit() failed!");
-            return;
-        }
-
-        s_initOnce = true;
-    }
-
-    windowHandle = static_cast<void*>(glfwCreateWindow(init.pixel_width(), 
-                                                       init.pixel_height(), 
-                                                       init.title.c_str(), 
-                                                       NULL, 
-                                                       NULL));
-    if (windowHandle == nullptr)
-    {
-        glfwTerminate();
-        debug::trace("platform::display::initialize glfwCreateWindow() failed!");
-        return;
-    }
-
-    glfwMakeContextCurrent(static_cast<GLFWwindow*>(windowHandle));
-
-    pixelBuffer.clear();
-    pixelBuffer.resize(init.width); // pixelBuffer[x][y]
-    for (auto& row : pixelBuffer) // for each row, add a column
-        row.resize(init.height, (rand() % 2) == 0 ? // randomly color each column
-                                    init.bg_color : init.fg_color);
-
-    debug::trace("platform::display::initialize completed.");
+    memset(&frame, 0, sizeof(frame));
 }
 
-bool platform::display::ui_close(void) 
+void platform::display::vblank(mpu::framebuffer const& fb)
 {
-    return glfwWindowShouldClose(static_cast<GLFWwindow *>(windowHandle));
+    frame = fb;
 }
 
-void platform::display::update(void)
+void platform::display::test_sanity(void)
 {
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    glMatrixMode( GL_PROJECTION );
-    glLoadIdentity();
-    glViewport(0, 0, descriptor.pixel_width(), descriptor.pixel_height());
-    
-    uint8_t *pixelData = new uint8_t[descriptor.pixel_width() * descriptor.pixel_height()];
+    TRACE_INFO("platform::display::test_sanity begin");
 
-    for (int x = 0; x < descriptor.pixel_width(); ++x)
+    mpu::framebuffer fb;
+    memset(&fb, 0, sizeof(fb));
+    fb.rows[0] = 1ull << 63;
+    vblank(fb);
+    if (frame.pixel(0, 0) == false)
     {
-        for (int y = 0; y < descriptor.pixel_height(); ++y)
-        {
-            pixelData[x + y * descriptor.pixel_width()] = pixelBuffer[x / descriptor.pixel_size][y / descriptor.pixel_size];
-        }
+        TRACE_ERROR("platform::display::test_sanity vblank did not keep the frame");
+    }
+    clear_screen();
+    if (frame.pixel(0, 0))
+    {
+        TRACE_ERROR("platform::display::test_sanity clear_screen did not clear the frame");
     }
 
-    glDrawPixels(descriptor.pixel_width(),
-                 descriptor.pixel_height(),
-                 GL_RGB,
-                 GL_UNSIGNED_BYTE_3_3_2,
-                 pixelData);
-    
-    delete[] pixelData;
-
-    glfwSwapBuffers(static_cast<GLFWwindow*>(windowHandle));
-
-    glfwPollEvents();
-}
-
-void platform::display::set_pixel(int32_t x, int32_t y)
-{
-    pixel(x, y, descriptor.fg_color);
-}
-
-void platform::display::clear_pixel(int32_t x, int32_t y)
-{
-    pixel(x, y, descriptor.bg_color);
-}
-
-void platform::display::pixel(int32_t x, int32_t y, uint8_t rgb)
-{
-    pixelBuffer[x][y] = rgb;
-}
-
-void platform::display::clear_screen(void)
-{
-    for (int x = 0; x < descriptor.width; ++x)
-        for (int y = 0; y < descriptor.height; ++y)
-            pixelBuffer[x][y] = descriptor.bg_color;
+    TRACE_INFO("platform::display::test_sanity completed.");
 }
 
-void platform::display::test_sanity(void)
+bool platform::null_display::initialize(display_descriptor const &init)
 {
-    debug::trace("platform::display::test_sanity begin");
-
-    debug::trace("platform::display::test_sanity::test_window begin");
-    test_window();
-    debug::trace("platform::display::test_sanity::test_window completed.");
-
-    debug::trace("platform::display::test_sanity completed.");
+    descriptor = init;
+    clear_screen();
+    return true;
 }
 
-void platform::display::test_window(void)
+bool platform::parse_backend(std::string const &name, backend &kind)
 {
-    GLFWwindow* window;
-
-    /* Initialize the library */
-    if (!glfwInit())
+    if (name == "null")
     {
-        debug::trace("test_window -- glfwInit failed!");
-        return;
+        kind = backend::null;
     }
-
-    /* Create a windowed mode window and its OpenGL context */
-    window = glfwCreateWindow(640, 480, "Hello World", NULL, NULL);
-    if (!window)
+    else if (name == "offscreen")
     {
-        glfwTerminate();
-        debug::trace("test_window -- glfwCreateWindow failed!");
-        return;
+        kind = backend::offscreen;
     }
-
-    /* Make the window's context current */
-    glfwMakeContextCurrent(window);
-
-    /* Loop until the user closes the window */
-    for (int i = 0; i < 60 && !glfwWindowShouldClose(window); ++i)
+    else if (name == "glfw")
     {
-        /* Render here */
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        /* Swap front and back buffers */
-        glfwSwapBuffers(window);
-
-        /* Poll for and process events */
-        glfwPollEvents();
+        kind = backend::glfw;
     }
+    else
+    {
+        return false;
+    }
+    return true;
+}
 
-    glfwTerminate();
+std::unique_ptr<platform::display> platform::create_display(backend kind)
+{
+    switch (kind)
+    {
+        case backend::null:      return std::unique_ptr<display>(new null_display());
+        case backend::offscreen: return std::unique_ptr<display>(new offscreen_display());
+        case backend::glfw:      return std::unique_ptr<display>(new glfw_display());
+    }
+    return nullptr;
 }
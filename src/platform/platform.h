@@ -23,6 +23,7 @@
 #define __PLATFORM_H__
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -33,7 +34,7 @@ namespace platform
 {
     int32_t const     default_pixel_size     = 10;
     int32_t const     default_display_width  = 64;
-    int32_t const     default_display_height = 48;
+    int32_t const     default_display_height = 32;
     std::string const default_display_title  = "Chip-8";
     uint8_t const     default_bg_color       = 0; // 3 3 2 format
     uint8_t const     default_fg_color       = 255;
@@ -52,24 +53,84 @@ namespace platform
         int32_t pixel_height() const{return height* pixel_size;}
     };
 
+    // front-end display, implemented per backend
     class display : public debug::isanity_testable, public mpu::display_hook
     {
         public:
-            void initialize(display_descriptor const &init = display_descriptor());
-            void display_splash(void);
-            bool ui_close(void);
-            void update(void);
+            virtual ~display() {}
+
+            virtual bool initialize(display_descriptor const &init = display_descriptor()) = 0;
+            virtual bool ui_close(void) = 0;
+            virtual void update(void) = 0;
+
+            virtual void clear_screen(void);
+            virtual void vblank(mpu::framebuffer const& fb);
+            virtual void test_sanity(void);
+
+        protected:
+            display_descriptor descriptor;
+            mpu::framebuffer   frame; // last presented
+    };
+
+    enum class backend
+    {
+        null,      // discards frames
+        offscreen, // software renderer into an RGBA buffer, no display server needed
+        glfw,      // window through GLFW + OpenGL
+    };
+
+    bool parse_backend(std::string const &name, backend &kind);
+    std::unique_ptr<display> create_display(backend kind);
+
+    class null_display : public display
+    {
+        public:
+            virtual bool initialize(display_descriptor const &init = display_descriptor());
+            virtual bool ui_close(void) { return false; }
+            virtual void update(void)   {}
+    };
+
+    class offscreen_display : public display
+    {
+        public:
+            virtual bool initialize(display_descriptor const &init = display_descriptor());
+            virtual bool ui_close(void) { return false; }
+            virtual void update(void);
+
+            // RGBA8, pixel_width() x pixel_height(), valid after update()
+            uint32_t const* pixels(void) const { return rgba.data(); }
+            bool screenshot(std::string const &path) const;
+
+            virtual void test_sanity(void);
+
+        private:
+            std::vector<uint32_t> rgba;
+            uint32_t              bg;
+            uint32_t              fg;
+    };
+
+    class glfw_display : public display
+    {
+        public:
+            glfw_display();
+            virtual ~glfw_display();
+
+            virtual bool initialize(display_descriptor const &init = display_descriptor());
+            virtual bool ui_close(void);
+            virtual void update(void);
 
             void set_pixel(int32_t x, int32_t y);
             void clear_pixel(int32_t x, int32_t y);
             void pixel(int32_t x, int32_t y, uint8_t rgb);
-            
+
             virtual void clear_screen(void);
+            virtual void vblank(mpu::framebuffer const& fb);
             virtual void test_sanity(void);
+
         private:
-            display_descriptor                descriptor;
             void                             *windowHandle;
             std::vector<std::vector<uint8_t>> pixelBuffer;
+            std::vector<uint8_t>              pixelData;
 
             void test_window(void);
     };
@@ -0,0 +1,135 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "png.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    std::vector<uint32_t> crc_table(void)
+    {
+        std::vector<uint32_t> table(256);
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return table;
+    }
+
+    uint32_t crc32(uint8_t const *data, size_t size, uint32_t crc = 0)
+    {
+        static std::vector<uint32_t> const s_table = crc_table();
+
+        crc = ~crc;
+        for (size_t n = 0; n < size; ++n)
+        {
+            crc = s_table[(crc ^ data[n]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void put32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        out.push_back(value >> 24);
+        out.push_back(value >> 16);
+        out.push_back(value >> 8);
+        out.push_back(value);
+    }
+
+    void chunk(std::vector<uint8_t> &out, char const *type, std::vector<uint8_t> const &data)
+    {
+        put32(out, data.size());
+        size_t const start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        put32(out, crc32(&out[start], out.size() - start));
+    }
+
+    // zlib stream of stored deflate blocks, the images written here are too
+    // small to bother compressing
+    std::vector<uint8_t> zlib_stored(std::vector<uint8_t> const &raw)
+    {
+        size_t const max_block = 65535;
+
+        std::vector<uint8_t> zlib = { 0x78, 0x01 };
+        zlib.reserve(raw.size() + (raw.size() / max_block + 1) * 5 + 6);
+
+        size_t offset = 0;
+        do
+        {
+            size_t const size = std::min(max_block, raw.size() - offset);
+            bool const   last = offset + size == raw.size();
+            zlib.push_back(last ? 1 : 0);
+            zlib.push_back(size);
+            zlib.push_back(size >> 8);
+            zlib.push_back(~size);
+            zlib.push_back(~size >> 8);
+            zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+            offset += size;
+        } while (offset < raw.size());
+
+        uint32_t a = 1, b = 0;
+        for (uint8_t byte : raw)
+        {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        put32(zlib, (b << 16) | a);
+        return zlib;
+    }
+}
+
+bool platform::write_png(std::string const &path,
+                         uint32_t width,
+                         uint32_t height,
+                         uint8_t depth,
+                         png_color color,
+                         std::vector<uint8_t> const &scanlines)
+{
+    std::vector<uint8_t> header;
+    put32(header, width);
+    put32(header, height);
+    header.push_back(depth);
+    header.push_back(color);
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // no interlace
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    chunk(png, "IHDR", header);
+    chunk(png, "IDAT", zlib_stored(scanlines));
+    chunk(png, "IEND", std::vector<uint8_t>());
+
+    FILE *out = fopen(path.c_str(), "wb");
+    if (out == nullptr)
+    {
+        return false;
+    }
+    bool const written = fwrite(png.data(), 1, png.size(), out) == png.size();
+    return (fclose(out) == 0) && written;
+}
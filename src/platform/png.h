@@ -0,0 +1,47 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __PNG_H__
+#define __PNG_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace platform
+{
+    enum png_color
+    {
+        png_gray = 0,
+        png_rgba = 6,
+    };
+
+    // writes an uncompressed PNG, scanlines must already carry their filter
+    // byte (0) and be packed for the given bit depth and color type
+    bool write_png(std::string const &path,
+                   uint32_t width,
+                   uint32_t height,
+                   uint8_t depth,
+                   png_color color,
+                   std::vector<uint8_t> const &scanlines);
+}
+
+#endif//__PNG_H__
@@ -0,0 +1,248 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "recorder.h"
+#include "debug.h"
+#include "png.h"
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+platform::recorder::recorder() :
+    next(nullptr),
+    kind(y4m),
+    file(nullptr),
+    stop(false),
+    idle(false),
+    presented(0),
+    lost(0),
+    head(0),
+    tail(0)
+{
+}
+
+platform::recorder::~recorder()
+{
+    close();
+}
+
+bool platform::recorder::open(std::string const &target, mpu::display_hook *display)
+{
+    close();
+
+    next = display;
+    path = target;
+    kind = (path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0) ? y4m : png_sequence;
+
+    if (kind == y4m)
+    {
+        file = fopen(path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            TRACE_ERROR("platform::recorder::open cannot create y4m file");
+            return false;
+        }
+        fprintf(file, "YUV4MPEG2 W%u H%u F60:1 Ip A1:1 Cmono\n",
+                mpu::framebuffer::width, mpu::framebuffer::height);
+    }
+
+    stop = false;
+    idle = false;
+    memset(&last, 0, sizeof(last));
+    presented = 0;
+    lost = 0;
+    head = 0;
+    tail = 0;
+    writer = std::thread(&recorder::run, this);
+
+    TRACE_VERBOSE("platform::recorder::open completed.");
+    return true;
+}
+
+void platform::recorder::close(void)
+{
+    if (writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stop = true;
+        }
+        wake.notify_one();
+        writer.join();
+    }
+    if (file)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+    if (lost)
+    {
+        TRACE_WARN("platform::recorder dropped {} of {} frames", lost.load(), presented.load());
+    }
+}
+
+void platform::recorder::clear_screen(void)
+{
+    if (next)
+    {
+        next->clear_screen();
+    }
+}
+
+void platform::recorder::vblank(mpu::framebuffer const& fb)
+{
+    uint64_t const frame = presented.fetch_add(1, std::memory_order_relaxed);
+
+    // the first frame is always queued, after that only changes
+    if (writer.joinable() && (frame == 0 || memcmp(&last, &fb, sizeof(fb)) != 0))
+    {
+        uint64_t const filled = head.load(std::memory_order_relaxed);
+        if (filled - tail.load(std::memory_order_acquire) < pool_frames)
+        {
+            slot &target = pool[filled & (pool_frames - 1)];
+            target.frame = frame;
+            target.fb = fb;
+            last = fb;
+            head.store(filled + 1, std::memory_order_release);
+
+            if (idle.load(std::memory_order_acquire))
+            {
+                wake.notify_one();
+            }
+        }
+        else
+        {
+            // never block the emulation thread, the writer fills the gap
+            lost.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (next)
+    {
+        next->vblank(fb);
+    }
+}
+
+void platform::recorder::run(void)
+{
+    slot previous;
+    bool havePrevious = false;
+
+    for (;;)
+    {
+        uint64_t const taken = tail.load(std::memory_order_relaxed);
+        if (taken == head.load(std::memory_order_acquire))
+        {
+            if (stop)
+            {
+                break;
+            }
+
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            idle.store(true, std::memory_order_release);
+            if (taken == head.load(std::memory_order_acquire) && stop == false)
+            {
+                wake.wait_for(lock, std::chrono::milliseconds(10));
+            }
+            idle.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        slot const current = pool[taken & (pool_frames - 1)];
+        tail.store(taken + 1, std::memory_order_release);
+
+        if (havePrevious)
+        {
+            // unchanged (or dropped) frames in between repeat the last one
+            repeat_until(previous, current.frame);
+        }
+        write(current, false);
+
+        previous = current;
+        havePrevious = true;
+    }
+
+    if (havePrevious)
+    {
+        repeat_until(previous, presented.load(std::memory_order_relaxed));
+    }
+}
+
+void platform::recorder::repeat_until(slot const &frame, uint64_t end)
+{
+    for (uint64_t n = frame.frame + 1; n < end; ++n)
+    {
+        write(frame, true);
+    }
+}
+
+void platform::recorder::write(slot const &frame, bool repeat)
+{
+    if (kind == png_sequence)
+    {
+        if (repeat == false)
+        {
+            write_png(frame);
+        }
+        return;
+    }
+
+    if (repeat == false)
+    {
+        for (uint32_t y = 0; y < mpu::framebuffer::height; ++y)
+        {
+            for (uint32_t x = 0; x < mpu::framebuffer::width; ++x)
+            {
+                luma[y * mpu::framebuffer::width + x] = frame.fb.pixel(x, y) ? 0xFF : 0x00;
+            }
+        }
+    }
+
+    fputs("FRAME\n", file);
+    fwrite(luma, 1, sizeof(luma), file);
+}
+
+void platform::recorder::write_png(slot const &frame)
+{
+    uint32_t const width  = mpu::framebuffer::width;
+    uint32_t const height = mpu::framebuffer::height;
+    uint32_t const stride = width / 8 + 1; // filter byte + 1 bit per pixel
+
+    // raw scanlines, filter 0, leftmost pixel in the high bit like the framebuffer
+    std::vector<uint8_t> raw;
+    raw.reserve(stride * height);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        raw.push_back(0);
+        for (int shift = 56; shift >= 0; shift -= 8)
+        {
+            raw.push_back(frame.fb.rows[y] >> shift);
+        }
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "_%08llu.png", static_cast<unsigned long long>(frame.frame));
+    if (platform::write_png(path + name, width, height, 1, png_gray, raw) == false)
+    {
+        TRACE_ERROR("platform::recorder cannot create png for frame {}", frame.frame);
+    }
+}
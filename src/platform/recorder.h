@@ -0,0 +1,102 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __RECORDER_H__
+#define __RECORDER_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "chip8.h"
+
+namespace platform
+{
+    // records every presented frame at native resolution
+    //
+    // sits in front of another display_hook (or none when headless). vblank
+    // copies each changed framebuffer into a fixed pool shared with a
+    // background writer thread and never waits: if the writer falls behind by
+    // more than the pool, frames are dropped and counted. unchanged frames
+    // only advance the frame counter, the writer expands them back into
+    // repeats and streams the result to
+    //      "<path>.y4m"    YUV4MPEG2 mono at 60fps, repeats reuse the last frame
+    //      anything else   1-bit PNG per changed frame, "<path>_<frame>.png"
+    class recorder : public mpu::display_hook
+    {
+        public:
+            enum format
+            {
+                y4m,
+                png_sequence,
+            };
+
+            const static uint32_t pool_frames = 1024; // power of 2
+
+            recorder();
+            ~recorder();
+
+            bool open(std::string const &path, mpu::display_hook *next = nullptr);
+            void close(void);
+            bool is_open(void) const { return writer.joinable(); }
+
+            uint64_t frames(void) const  { return presented.load(std::memory_order_relaxed); }
+            uint64_t dropped(void) const { return lost.load(std::memory_order_relaxed); }
+
+            virtual void clear_screen(void);
+            virtual void vblank(mpu::framebuffer const& fb);
+
+        private:
+            struct slot
+            {
+                uint64_t           frame;
+                mpu::framebuffer   fb;
+            };
+
+            mpu::display_hook     *next;
+            format                 kind;
+            std::string            path;
+            FILE                  *file;
+            std::thread            writer;
+            std::atomic<bool>      stop;
+            std::atomic<bool>      idle;    // writer is waiting for frames
+            std::mutex             wakeMutex;
+            std::condition_variable wake;
+            mpu::framebuffer       last;    // producer side, last frame queued
+            std::atomic<uint64_t>  presented;
+            std::atomic<uint64_t>  lost;
+            std::atomic<uint64_t>  head;    // producer, slots filled
+            std::atomic<uint64_t>  tail;    // consumer, slots released
+            slot                   pool[pool_frames];
+            uint8_t                luma[mpu::framebuffer::width * mpu::framebuffer::height];
+
+            void run(void);
+            void write(slot const &frame, bool repeat);
+            void repeat_until(slot const &frame, uint64_t end);
+            void write_png(slot const &frame);
+    };
+}
+
+#endif//__RECORDER_H__
@@ -0,0 +1,176 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "rom.h"
+#include "debug.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+rom::image::image(uint8_t const *data, uint32_t size, uint64_t hash) :
+    contentHash(hash),
+    bytes(data, data + size),
+    decoded(size)
+{
+    // the last instruction reads past the program, memory there is zero after boot
+    for (uint32_t n = 0; n < size; ++n)
+    {
+        uint8_t const low = (n + 1 < size) ? data[n + 1] : 0;
+        decoded[n] = mpu::chip8::decode((data[n] << 8u) | low);
+    }
+}
+
+uint64_t rom::hash(uint8_t const *data, size_t size)
+{
+    // FNV-1a
+    uint64_t value = 0xCBF29CE484222325ull;
+    for (size_t n = 0; n < size; ++n)
+    {
+        value ^= data[n];
+        value *= 0x100000001B3ull;
+    }
+    return value;
+}
+
+rom::cache& rom::cache::instance(void)
+{
+    static cache s_cache;
+    return s_cache;
+}
+
+rom::image_ptr rom::cache::load(std::string const &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        TRACE_WARN("rom::cache::load cannot open ROM");
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        TRACE_WARN("rom::cache::load cannot stat ROM, errno {}", errno);
+        ::close(fd);
+        return nullptr;
+    }
+    if (info.st_size <= 0 || info.st_size > max_size)
+    {
+        TRACE_WARN("rom::cache::load ROM size {} is invalid", info.st_size);
+        ::close(fd);
+        return nullptr;
+    }
+
+    file_key const key(info.st_dev, info.st_ino, info.st_size,
+                       info.st_mtim.tv_sec, info.st_mtim.tv_nsec);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto known = files.find(key);
+        if (known != files.end())
+        {
+            ::close(fd);
+            known->second.lastUse = ++useClock;
+            return known->second.image;
+        }
+    }
+
+    void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        TRACE_WARN("rom::cache::load cannot map ROM");
+        return nullptr;
+    }
+
+    uint8_t const *data = static_cast<uint8_t const*>(mapping);
+    image_ptr loaded = insert(data, info.st_size, hash(data, info.st_size));
+    munmap(mapping, info.st_size);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entry &recorded = files[key];
+    recorded.image = loaded;
+    recorded.lastUse = ++useClock;
+    trim(files);
+    return loaded;
+}
+
+rom::image_ptr rom::cache::load(uint8_t const *data, size_t size)
+{
+    if (data == nullptr || size == 0 || size > max_size)
+    {
+        TRACE_WARN("rom::cache::load ROM size {} is invalid", size);
+        return nullptr;
+    }
+    return insert(data, size, hash(data, size));
+}
+
+rom::image_ptr rom::cache::insert(uint8_t const *data, size_t size, uint64_t contentHash)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto known = images.find(contentHash);
+        if (known != images.end() &&
+            known->second.image->size() == size &&
+            memcmp(known->second.image->data(), data, size) == 0)
+        {
+            known->second.lastUse = ++useClock;
+            return known->second.image;
+        }
+    }
+
+    // decode outside the lock, a racing loader of the same content wins harmlessly
+    image_ptr created = std::make_shared<image const>(data, size, contentHash);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entry const fresh = { created, ++useClock };
+    auto inserted = images.insert(std::make_pair(contentHash, fresh));
+    if (inserted.second)
+    {
+        trim(images);
+        return created;
+    }
+    if (inserted.first->second.image->size() == size &&
+        memcmp(inserted.first->second.image->data(), data, size) == 0)
+    {
+        inserted.first->second.lastUse = useClock;
+        return inserted.first->second.image;
+    }
+    // on a hash collision the new image is returned unshared
+    return created;
+}
+
+size_t rom::cache::size(void) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return images.size();
+}
+
+void rom::cache::clear(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    images.clear();
+    files.clear();
+}
@@ -0,0 +1,119 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __ROM_H__
+#define __ROM_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "chip8.h"
+
+namespace rom
+{
+    const static uint32_t max_size = mpu::chip8::memory_size - mpu::chip8::program_start;
+
+    // immutable program bytes plus their pre-decoded instructions,
+    // shared by every instance booting the same content
+    class image
+    {
+        public:
+            image(uint8_t const *data, uint32_t size, uint64_t hash);
+
+            uint64_t hash(void) const                { return contentHash; }
+            uint32_t size(void) const                { return bytes.size(); }
+            uint8_t const* data(void) const          { return bytes.data(); }
+            mpu::decoded_op const* code(void) const  { return decoded.data(); }
+
+            void boot(mpu::chip8 &cpu) const { cpu.boot(data(), size(), code()); }
+
+        private:
+            uint64_t                     contentHash;
+            std::vector<uint8_t>         bytes;
+            std::vector<mpu::decoded_op> decoded;
+    };
+
+    typedef std::shared_ptr<image const> image_ptr;
+
+    uint64_t hash(uint8_t const *data, size_t size);
+
+    // process-wide cache keyed by content hash. files are mapped read-only
+    // and only mapped again when their identity (device, inode, size, mtime)
+    // changes, so booting thousands of instances from a few hundred ROMs
+    // costs one stat() per boot. Both indexes keep the capacity most
+    // recently used entries, evicted images live on while instances share them.
+    class cache
+    {
+        public:
+            const static size_t capacity = 256;
+
+            static cache& instance(void);
+
+            // returns nullptr if the file is missing, empty or larger than max_size
+            image_ptr load(std::string const &path);
+            image_ptr load(uint8_t const *data, size_t size);
+
+            size_t size(void) const;
+            void clear(void);
+
+        private:
+            typedef std::tuple<uint64_t, uint64_t, uint64_t, int64_t, int64_t> file_key;
+
+            struct entry
+            {
+                image_ptr image;
+                uint64_t  lastUse;
+            };
+
+            mutable std::mutex         mutex;
+            std::map<uint64_t, entry>  images; // by content hash
+            std::map<file_key, entry>  files;  // by file identity
+            uint64_t                   useClock = 0;
+
+            image_ptr insert(uint8_t const *data, size_t size, uint64_t contentHash);
+
+            // drops the least recently used entries beyond capacity, caller holds mutex
+            template <typename Key>
+            static void trim(std::map<Key, entry> &entries)
+            {
+                while (entries.size() > capacity)
+                {
+                    auto oldest = entries.begin();
+                    for (auto it = entries.begin(); it != entries.end(); ++it)
+                    {
+                        if (it->second.lastUse < oldest->second.lastUse)
+                        {
+                            oldest = it;
+                        }
+                    }
+                    entries.erase(oldest);
+                }
+            }
+    };
+}
+
+#endif//__ROM_H__
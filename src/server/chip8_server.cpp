@@ -0,0 +1,87 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// chip8_server: hosts emulator instances for local clients, see protocol.h
+//
+//   chip8_server [-socket PATH] [-threads N] [-instances N] [-d]
+
+#include "server.h"
+#include "debug.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static server::host *s_host = nullptr;
+
+static void on_signal(int)
+{
+    if (s_host)
+    {
+        s_host->stop();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = "/tmp/chip8.sock";
+    uint32_t threads = 0;
+    uint32_t instances = server::host::default_instance_budget;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string opt(argv[i]);
+        if (opt == "-socket" && i + 1 < argc)
+            path = argv[++i];
+        else if (opt == "-threads" && i + 1 < argc)
+            threads = strtoul(argv[++i], nullptr, 0);
+        else if (opt == "-instances" && i + 1 < argc)
+            instances = strtoul(argv[++i], nullptr, 0);
+        else if (opt == "-d")
+            debug::enable();
+        else
+        {
+            printf("usage: chip8_server [-socket PATH] [-threads N] [-instances N] [-d]\n");
+            return 1;
+        }
+    }
+
+    server::host host(threads, instances);
+    if (host.open(path) == false)
+    {
+        printf("chip8_server: cannot listen on \"%s\"\n", path.c_str());
+        return 1;
+    }
+
+    s_host = &host;
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    printf("chip8_server: listening on %s\n", path.c_str());
+    fflush(stdout);
+    host.run();
+
+    s_host = nullptr;
+    host.close();
+    debug::trace_flush();
+    return 0;
+}
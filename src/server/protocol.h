@@ -0,0 +1,149 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __PROTOCOL_H__
+#define __PROTOCOL_H__
+
+#include <cstdint>
+
+// chip8_server wire format
+//
+// clients connect to a SOCK_SEQPACKET Unix domain socket, one message per
+// packet, all fields in host byte order. A session starts with a hello that
+// creates its instances; the reply carries a shared memory file descriptor
+// (SCM_RIGHTS) holding one observation ring per instance:
+//
+//      observation[instance * depth + sequence % depth]
+//
+// afterwards every message is a batch of commands. The server executes the
+// batch across its thread pool (commands for the same instance keep their
+// order) and answers with one result per command once every observation of
+// the batch is written, so the reply orders the shared memory writes before
+// any client read. Older records stay in the ring until overwritten depth
+// steps later.
+namespace server
+{
+    const static uint32_t magic         = 0x38504843; // "CHP8"
+    const static uint32_t version       = 1;
+    const static uint32_t max_watches   = 8;
+    const static uint32_t max_path      = 256;
+    const static uint32_t max_commands  = 8192;       // per batch
+    const static uint32_t max_instances = 1024;       // per session, ~30KiB each
+    const static uint32_t max_depth     = 64;
+
+    enum message_type : uint32_t
+    {
+        msg_hello = 1,
+        msg_hello_reply,
+        msg_batch,
+        msg_batch_reply,
+    };
+
+    enum status : uint32_t
+    {
+        ok = 0,
+        bad_message,   // malformed or unexpected message
+        bad_instance,
+        bad_rom,
+        out_of_memory,
+    };
+
+    struct header
+    {
+        uint32_t magic;
+        uint32_t type;  // message_type
+        uint32_t count; // commands or results following a batch header
+        uint32_t reserved;
+    };
+
+    struct hello
+    {
+        header   head;
+        uint32_t version;
+        uint32_t instances;
+        uint32_t instructions;         // per frame, 0 = default
+        uint32_t seed;                 // instance n is seeded with seed + n, 0 = default seed for all
+        uint32_t depth;                // observations kept per instance, 0 = 1
+        uint32_t watch_count;
+        uint16_t watch[max_watches];   // memory addresses copied into every observation (scores, lives)
+        char     rom[max_path];        // path on the server host, nul terminated
+    };
+
+    struct hello_reply
+    {
+        header   head;
+        uint32_t status;
+        uint32_t instances;
+        uint32_t depth;
+        uint32_t record_size;          // sizeof(observation)
+        uint64_t segment_size;         // bytes to map from the passed descriptor
+    };
+
+    enum command_op : uint16_t
+    {
+        op_reset = 1, // reboot the ROM, arg = new seed (0 keeps the current one)
+        op_keys,      // set the key mask
+        op_step,      // run arg frames (0 = 1) after applying the key mask
+    };
+
+    struct command
+    {
+        uint16_t op;       // command_op
+        uint16_t keys;     // op_keys, op_step: bit n = key n down
+        uint32_t instance;
+        uint32_t arg;
+    };
+
+    struct result
+    {
+        uint32_t instance;
+        uint32_t status;
+        uint64_t sequence; // observation written by this command, ring index is sequence % depth
+    };
+
+    // one snapshot, written after reset and step commands
+    struct observation
+    {
+        uint64_t sequence;             // 1 for the first snapshot after hello
+        uint64_t frames;
+        uint64_t cycles;
+        uint32_t faults;
+        uint16_t pc;
+        uint16_t i;
+        uint8_t  v[16];
+        uint16_t stack_pointer;
+        uint16_t keys;
+        uint8_t  delay;
+        uint8_t  sound;
+        uint8_t  watch[max_watches];   // bytes at hello::watch
+        uint8_t  pad[2];
+        uint64_t rows[32];             // packed framebuffer, bit 63 is x = 0
+    };
+
+    static_assert(sizeof(header) == 16, "server::header is a wire format");
+    static_assert(sizeof(hello) == 312, "server::hello is a wire format");
+    static_assert(sizeof(hello_reply) == 40, "server::hello_reply is a wire format");
+    static_assert(sizeof(command) == 12, "server::command is a wire format");
+    static_assert(sizeof(result) == 16, "server::result is a wire format");
+    static_assert(sizeof(observation) == 320, "server::observation is a shared layout");
+}
+
+#endif//__PROTOCOL_H__
@@ -0,0 +1,520 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "server.h"
+#include "debug.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    const size_t max_request = sizeof(server::hello) > sizeof(server::header) + server::max_commands * sizeof(server::command) ?
+                               sizeof(server::hello) : sizeof(server::header) + server::max_commands * sizeof(server::command);
+    const size_t max_reply   = sizeof(server::header) + server::max_commands * sizeof(server::result);
+    const int    poll_ms     = 100; // only bounds how long stop() takes
+
+    // observation memory for one session, unlinked right away so it
+    // disappears with the last mapping
+    int create_segment(size_t size)
+    {
+        static std::atomic<uint32_t> s_counter(0);
+        std::string const name = "/chip8-server." + std::to_string(getpid()) + "." + std::to_string(s_counter++);
+
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0)
+        {
+            return -1;
+        }
+        shm_unlink(name.c_str());
+
+        if (ftruncate(fd, size) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+server::host::session::session(int socket) :
+    fd(socket),
+    ready(false),
+    instructions(mpu::chip8::default_frame_instructions),
+    depth(1),
+    watchCount(0),
+    ring(nullptr),
+    ringSize(0)
+{
+}
+
+server::host::session::~session()
+{
+    if (ring)
+    {
+        munmap(ring, ringSize);
+    }
+    ::close(fd);
+}
+
+server::host::host(uint32_t threads, uint32_t instanceBudget) :
+    pool(threads),
+    instanceBudget(instanceBudget),
+    listener(-1),
+    stopping(false),
+    request(max_request),
+    reply(max_reply)
+{
+}
+
+server::host::~host()
+{
+    close();
+}
+
+bool server::host::open(std::string const &path)
+{
+    close();
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        TRACE_ERROR("server::host::open socket path is too long");
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+
+    listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listener < 0)
+    {
+        TRACE_ERROR("server::host::open cannot create socket, errno {}", errno);
+        return false;
+    }
+
+    // a socket file left by a previous run would make bind fail
+    unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, 64) != 0)
+    {
+        TRACE_ERROR("server::host::open cannot listen, errno {}", errno);
+        ::close(listener);
+        listener = -1;
+        return false;
+    }
+
+    socketPath = path;
+    stopping = false;
+    TRACE_INFO("server::host::open listening on {} threads", pool.size());
+    return true;
+}
+
+void server::host::close(void)
+{
+    sessions.clear();
+    if (listener >= 0)
+    {
+        ::close(listener);
+        unlink(socketPath.c_str());
+    }
+    listener = -1;
+}
+
+void server::host::run(void)
+{
+    std::vector<pollfd> fds;
+    while (stopping == false && listener >= 0)
+    {
+        fds.clear();
+        fds.push_back(pollfd{ listener, POLLIN, 0 });
+        for (auto const &client : sessions)
+        {
+            fds.push_back(pollfd{ client->fd, POLLIN, 0 });
+        }
+
+        if (poll(fds.data(), fds.size(), poll_ms) <= 0)
+        {
+            continue;
+        }
+
+        // sessions only change below, so fds[n + 1] still belongs to sessions[n]
+        std::vector<bool> closed(sessions.size(), false);
+        for (size_t n = 0; n < sessions.size(); ++n)
+        {
+            short const events = fds[n + 1].revents;
+            if (events & POLLIN)
+            {
+                closed[n] = serve(*sessions[n]) == false;
+            }
+            else if (events & (POLLHUP | POLLERR | POLLNVAL))
+            {
+                closed[n] = true;
+            }
+        }
+        for (size_t n = sessions.size(); n-- > 0;)
+        {
+            if (closed[n])
+            {
+                TRACE_VERBOSE("server::host::run client {} disconnected", sessions[n]->fd);
+                sessions.erase(sessions.begin() + n);
+            }
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            accept_client();
+        }
+    }
+}
+
+void server::host::accept_client(void)
+{
+    int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    // a full batch reply goes out as one packet
+    int buffer = max_reply * 2;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+
+    sessions.push_back(std::unique_ptr<session>(new session(fd)));
+    TRACE_VERBOSE("server::host::accept_client client {} connected", fd);
+}
+
+bool server::host::serve(session &client)
+{
+    iovec io = { request.data(), request.size() };
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+
+    ssize_t const size = recvmsg(client.fd, &message, MSG_DONTWAIT);
+    if (size < 0)
+    {
+        return errno == EAGAIN || errno == EINTR;
+    }
+    if (size == 0)
+    {
+        return false; // orderly shutdown
+    }
+
+    header const *head = reinterpret_cast<header const*>(request.data());
+    if ((message.msg_flags & MSG_TRUNC) || static_cast<size_t>(size) < sizeof(header) || head->magic != magic)
+    {
+        TRACE_WARN("server::host::serve malformed message from client {}", client.fd);
+        return false;
+    }
+
+    if (head->type == msg_hello && client.ready == false)
+    {
+        return handle_hello(client, size);
+    }
+    if (head->type == msg_batch && client.ready)
+    {
+        return handle_batch(client, size);
+    }
+
+    TRACE_WARN("server::host::serve unexpected message {} from client {}", head->type, client.fd);
+    return false;
+}
+
+bool server::host::handle_hello(session &client, size_t size)
+{
+    hello const *in = reinterpret_cast<hello const*>(request.data());
+    hello_reply *out = reinterpret_cast<hello_reply*>(reply.data());
+    memset(out, 0, sizeof(*out));
+    out->head.magic = magic;
+    out->head.type = msg_hello_reply;
+    out->record_size = sizeof(observation);
+
+    if (size != sizeof(hello) || in->version != version ||
+        in->instances == 0 || in->instances > max_instances ||
+        in->depth > max_depth || in->watch_count > max_watches ||
+        memchr(in->rom, 0, sizeof(in->rom)) == nullptr)
+    {
+        out->status = bad_message;
+        return send_reply(client, sizeof(*out));
+    }
+
+    client.image = rom::cache::instance().load(std::string(in->rom));
+    if (client.image == nullptr)
+    {
+        out->status = bad_rom;
+        return send_reply(client, sizeof(*out));
+    }
+
+    // every session's instances live in this process, share one budget
+    size_t inUse = 0;
+    for (auto const &other : sessions)
+    {
+        inUse += other->instances.size();
+    }
+    if (inUse + in->instances > instanceBudget)
+    {
+        TRACE_WARN("server::host::handle_hello client {} asked for {} instances, {} in use",
+                   client.fd, in->instances, inUse);
+        out->status = out_of_memory;
+        return send_reply(client, sizeof(*out));
+    }
+
+    try
+    {
+        client.instances.resize(in->instances);
+    }
+    catch (std::bad_alloc const &)
+    {
+        TRACE_ERROR("server::host::handle_hello cannot allocate {} instances", in->instances);
+        std::vector<instance>().swap(client.instances);
+        out->status = out_of_memory;
+        return send_reply(client, sizeof(*out));
+    }
+
+    client.instructions = in->instructions ? in->instructions : mpu::chip8::default_frame_instructions;
+    client.depth = in->depth ? in->depth : 1;
+    client.watchCount = in->watch_count;
+    for (uint32_t n = 0; n < client.watchCount; ++n)
+    {
+        client.watch[n] = in->watch[n] & mpu::chip8::address_mask;
+    }
+
+    client.ringSize = static_cast<size_t>(in->instances) * client.depth * sizeof(observation);
+    int segment = create_segment(client.ringSize);
+    void *mapping = segment < 0 ? MAP_FAILED :
+                    mmap(nullptr, client.ringSize, PROT_READ | PROT_WRITE, MAP_SHARED, segment, 0);
+    if (mapping == MAP_FAILED)
+    {
+        TRACE_ERROR("server::host::handle_hello cannot create {} byte observation segment", client.ringSize);
+        if (segment >= 0)
+        {
+            ::close(segment);
+        }
+        client.ringSize = 0;
+        std::vector<instance>().swap(client.instances);
+        out->status = out_of_memory;
+        return send_reply(client, sizeof(*out));
+    }
+    client.ring = static_cast<observation*>(mapping);
+
+    uint32_t const seed = in->seed;
+    pool.parallel_for(in->instances, [&](uint32_t index) {
+        instance &target = client.instances[index];
+        if (seed)
+        {
+            target.cpu.seed(seed + index);
+        }
+        client.image->boot(target.cpu);
+        snapshot(client, index);
+    });
+
+    client.ready = true;
+    out->status = ok;
+    out->instances = in->instances;
+    out->depth = client.depth;
+    out->segment_size = client.ringSize;
+
+    bool const sent = send_reply(client, sizeof(*out), segment);
+    ::close(segment);
+
+    TRACE_INFO("server::host::handle_hello client {} runs {} instances", client.fd, in->instances);
+    return sent;
+}
+
+bool server::host::handle_batch(session &client, size_t size)
+{
+    header const *head = reinterpret_cast<header const*>(request.data());
+    command const *commands = reinterpret_cast<command const*>(head + 1);
+    uint32_t const count = head->count;
+
+    if (count > max_commands || size != sizeof(header) + count * sizeof(command))
+    {
+        TRACE_WARN("server::host::handle_batch bad batch size from client {}", client.fd);
+        return false;
+    }
+
+    header *out = reinterpret_cast<header*>(reply.data());
+    result *results = reinterpret_cast<result*>(out + 1);
+    memset(out, 0, sizeof(*out));
+    out->magic = magic;
+    out->type = msg_batch_reply;
+    out->count = count;
+
+    // commands for one instance run in order on one thread, different
+    // instances run in parallel. batches usually list each instance once
+    // and in order, which needs no sorting.
+    order.resize(count);
+    for (uint32_t n = 0; n < count; ++n)
+    {
+        order[n] = n;
+    }
+    auto const by_instance = [&](uint32_t a, uint32_t b) { return commands[a].instance < commands[b].instance; };
+    if (std::is_sorted(order.begin(), order.end(), by_instance) == false)
+    {
+        std::stable_sort(order.begin(), order.end(), by_instance);
+    }
+
+    std::vector<uint32_t> groups; // first position in order of each instance's run
+    for (uint32_t n = 0; n < count; ++n)
+    {
+        if (n == 0 || commands[order[n]].instance != commands[order[n - 1]].instance)
+        {
+            groups.push_back(n);
+        }
+    }
+    groups.push_back(count);
+
+    pool.parallel_for(groups.size() - 1, [&](uint32_t group) {
+        for (uint32_t n = groups[group]; n < groups[group + 1]; ++n)
+        {
+            execute(client, commands[order[n]], results[order[n]]);
+        }
+    });
+
+    return send_reply(client, sizeof(header) + count * sizeof(result));
+}
+
+void server::host::execute(session &client, command const &cmd, result &out)
+{
+    out.instance = cmd.instance;
+    out.sequence = 0;
+    if (cmd.instance >= client.instances.size())
+    {
+        out.status = bad_instance;
+        return;
+    }
+
+    instance &target = client.instances[cmd.instance];
+    switch (cmd.op)
+    {
+        case op_reset:
+            if (cmd.arg)
+            {
+                target.cpu.seed(cmd.arg);
+            }
+            client.image->boot(target.cpu);
+            snapshot(client, cmd.instance);
+            break;
+
+        case op_keys:
+            target.cpu.set_keys(cmd.keys);
+            break;
+
+        case op_step:
+            target.cpu.set_keys(cmd.keys);
+            for (uint32_t frame = 0; frame < std::max(cmd.arg, 1u); ++frame)
+            {
+                target.cpu.frame(client.instructions);
+            }
+            snapshot(client, cmd.instance);
+            break;
+
+        default:
+            out.status = bad_message;
+            return;
+    }
+
+    out.status = ok;
+    out.sequence = target.sequence;
+}
+
+void server::host::snapshot(session &client, uint32_t index)
+{
+    instance &source = client.instances[index];
+    mpu::chip8 const &cpu = source.cpu;
+    uint64_t const sequence = ++source.sequence;
+
+    observation &record = client.ring[static_cast<size_t>(index) * client.depth + sequence % client.depth];
+    record.frames = cpu.get_frames();
+    record.cycles = cpu.get_cycles();
+    record.faults = cpu.get_faults();
+    record.pc = cpu.get_pc();
+    record.i = cpu.get_i();
+    for (uint32_t n = 0; n < mpu::chip8::num; ++n)
+    {
+        record.v[n] = cpu.get_register(static_cast<mpu::chip8::reg>(n));
+    }
+    record.stack_pointer = cpu.get_sp();
+    record.keys = cpu.get_keys();
+    record.delay = cpu.get_delay();
+    record.sound = cpu.get_sound();
+    for (uint32_t n = 0; n < client.watchCount; ++n)
+    {
+        record.watch[n] = cpu.memory()[client.watch[n]];
+    }
+    memcpy(record.rows, cpu.display().rows, sizeof(record.rows));
+
+    // clients polling the ring without waiting for the reply see the
+    // sequence only after the rest of the record
+    std::atomic_thread_fence(std::memory_order_release);
+    record.sequence = sequence;
+}
+
+bool server::host::send_reply(session &client, size_t size, int passFd)
+{
+    iovec io = { reply.data(), size };
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    if (passFd >= 0)
+    {
+        memset(control, 0, sizeof(control));
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &passFd, sizeof(int));
+    }
+
+    // one poll thread serves every session, so a client that stops reading
+    // must not stall the rest; with the send buffer sized for two replies a
+    // full one only means the client ignored its last reply, so drop it
+    ssize_t sent;
+    do
+    {
+        sent = sendmsg(client.fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent != static_cast<ssize_t>(size))
+    {
+        TRACE_WARN("server::host::send_reply client {} did not take the reply, errno {}", client.fd,
+                   sent < 0 ? errno : 0);
+        return false;
+    }
+    return true;
+}
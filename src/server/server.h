@@ -0,0 +1,104 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "chip8.h"
+#include "protocol.h"
+#include "rom.h"
+#include "thread_pool.h"
+
+namespace server
+{
+    // hosts sessions of emulator instances for clients on one Unix domain
+    // socket, see protocol.h. A single thread serves every connection, each
+    // batch is spread over the thread pool.
+    class host
+    {
+        public:
+            const static uint32_t default_instance_budget = 8192; // all sessions together
+
+            explicit host(uint32_t threads = 0, uint32_t instanceBudget = default_instance_budget);
+            ~host();
+
+            bool open(std::string const &path);
+            void close(void);
+
+            // serves clients until stop()
+            void run(void);
+            // async-signal-safe
+            void stop(void) { stopping = true; }
+
+        private:
+            struct instance
+            {
+                mpu::chip8 cpu;
+                uint64_t   sequence;
+
+                instance() : cpu(mpu::hardware_hooks()), sequence(0) {}
+            };
+
+            struct session
+            {
+                int                   fd;
+                bool                  ready;     // hello accepted
+                std::vector<instance> instances;
+                rom::image_ptr        image;
+                uint32_t              instructions;
+                uint32_t              depth;
+                uint32_t              watchCount;
+                uint16_t              watch[max_watches];
+                observation          *ring;
+                size_t                ringSize;
+
+                explicit session(int socket);
+                ~session();
+            };
+
+            util::thread_pool                     pool;
+            uint32_t                              instanceBudget;
+            int                                   listener;
+            std::string                           socketPath;
+            std::atomic<bool>                     stopping;
+            std::vector<std::unique_ptr<session>> sessions;
+            std::vector<uint8_t>                  request;
+            std::vector<uint8_t>                  reply;
+            std::vector<uint32_t>                 order;
+
+            void accept_client(void);
+            bool serve(session &client);
+            bool handle_hello(session &client, size_t size);
+            bool handle_batch(session &client, size_t size);
+            void execute(session &client, command const &cmd, result &out);
+            void snapshot(session &client, uint32_t index);
+            bool send_reply(session &client, size_t size, int passFd = -1);
+    };
+}
+
+#endif//__SERVER_H__
@@ -0,0 +1,229 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// chip8_server_test: protocol round trips against an in-process host, run by ctest
+
+#include "server.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    int s_failures = 0;
+
+    #define CHECK(expr)                                                   \
+        do                                                                \
+        {                                                                 \
+            if (!(expr))                                                  \
+            {                                                             \
+                printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+                ++s_failures;                                             \
+            }                                                             \
+        } while (0)
+
+    int connect_to(std::string const &path)
+    {
+        int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+        return fd;
+    }
+
+    // sends a hello and returns the reply, segment receives the passed descriptor or -1
+    server::hello_reply say_hello(int fd, std::string const &rom, uint32_t instances, uint32_t depth, int &segment)
+    {
+        server::hello in;
+        memset(&in, 0, sizeof(in));
+        in.head.magic = server::magic;
+        in.head.type = server::msg_hello;
+        in.version = server::version;
+        in.instances = instances;
+        in.depth = depth;
+        in.watch_count = 1;
+        in.watch[0] = 0x200;
+        strncpy(in.rom, rom.c_str(), sizeof(in.rom) - 1);
+        send(fd, &in, sizeof(in), 0);
+
+        server::hello_reply out;
+        memset(&out, 0, sizeof(out));
+        iovec io = { &out, sizeof(out) };
+        char control[CMSG_SPACE(sizeof(int))];
+        msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        segment = -1;
+        if (recvmsg(fd, &message, 0) == static_cast<ssize_t>(sizeof(out)))
+        {
+            cmsghdr *header = CMSG_FIRSTHDR(&message);
+            if (header && header->cmsg_type == SCM_RIGHTS)
+            {
+                memcpy(&segment, CMSG_DATA(header), sizeof(segment));
+            }
+        }
+        return out;
+    }
+
+    // sends commands and fills results, returns the number of results
+    uint32_t batch(int fd, server::command const *commands, uint32_t count, server::result *results)
+    {
+        char packet[sizeof(server::header) + 16 * sizeof(server::command)];
+        server::header head;
+        memset(&head, 0, sizeof(head));
+        head.magic = server::magic;
+        head.type = server::msg_batch;
+        head.count = count;
+        memcpy(packet, &head, sizeof(head));
+        memcpy(packet + sizeof(head), commands, count * sizeof(server::command));
+        send(fd, packet, sizeof(head) + count * sizeof(server::command), 0);
+
+        char reply[sizeof(server::header) + 16 * sizeof(server::result)];
+        ssize_t const size = recv(fd, reply, sizeof(reply), 0);
+        if (size < static_cast<ssize_t>(sizeof(server::header)))
+        {
+            return 0;
+        }
+        memcpy(&head, reply, sizeof(head));
+        memcpy(results, reply + sizeof(head), head.count * sizeof(server::result));
+        return head.count;
+    }
+}
+
+int main(void)
+{
+    std::string const base = "/tmp/chip8_server_test." + std::to_string(getpid());
+    std::string const socketPath = base + ".sock";
+    std::string const romPath = base + ".ch8";
+
+    // 6000 7001 1202: count up V0 forever
+    static uint8_t const program[] = { 0x60, 0x00, 0x70, 0x01, 0x12, 0x02 };
+    FILE *rom = fopen(romPath.c_str(), "wb");
+    CHECK(rom && fwrite(program, sizeof(program), 1, rom) == 1);
+    if (rom)
+    {
+        fclose(rom);
+    }
+
+    server::host host(2, 8);
+    if (host.open(socketPath) == false)
+    {
+        printf("cannot listen on %s\n", socketPath.c_str());
+        return 1;
+    }
+    std::thread serving([&host]() { host.run(); });
+
+    int client = connect_to(socketPath);
+    CHECK(client >= 0);
+
+    int segment = -1;
+    server::hello_reply reply = say_hello(client, base + ".missing", 4, 2, segment);
+    CHECK(reply.status == server::bad_rom);
+    reply = say_hello(client, romPath, server::max_instances + 1, 2, segment);
+    CHECK(reply.status == server::bad_message);
+    reply = say_hello(client, romPath, 9, 2, segment);
+    CHECK(reply.status == server::out_of_memory);
+
+    reply = say_hello(client, romPath, 4, 2, segment);
+    CHECK(reply.status == server::ok);
+    CHECK(reply.instances == 4);
+    CHECK(reply.record_size == sizeof(server::observation));
+    CHECK(segment >= 0);
+
+    // the budget of 8 is shared, 4 are left
+    int other = connect_to(socketPath);
+    int otherSegment = -1;
+    CHECK(say_hello(other, romPath, 5, 1, otherSegment).status == server::out_of_memory);
+    CHECK(say_hello(other, romPath, 4, 1, otherSegment).status == server::ok);
+    ::close(otherSegment);
+    ::close(other);
+
+    void *mapping = mmap(nullptr, reply.segment_size, PROT_READ, MAP_SHARED, segment, 0);
+    CHECK(mapping != MAP_FAILED);
+    server::observation const *ring = static_cast<server::observation const*>(mapping);
+
+    // out of order, repeated and invalid instances in one batch
+    server::command const commands[] = {
+        { server::op_step,  0x0001, 3, 2 },
+        { server::op_step,  0x0000, 1, 1 },
+        { server::op_step,  0x0000, 3, 1 },
+        { server::op_keys,  0x0010, 0, 0 },
+        { server::op_step,  0x0000, 7, 1 },
+        { server::op_reset, 0x0000, 1, 0 },
+    };
+    server::result results[6];
+    CHECK(batch(client, commands, 6, results) == 6);
+    CHECK(results[0].status == server::ok && results[0].sequence == 2);
+    CHECK(results[1].status == server::ok && results[1].sequence == 2);
+    CHECK(results[2].status == server::ok && results[2].sequence == 3);
+    CHECK(results[3].status == server::ok);
+    CHECK(results[4].instance == 7 && results[4].status == server::bad_instance);
+    CHECK(results[5].status == server::ok && results[5].sequence == 3);
+
+    if (mapping != MAP_FAILED)
+    {
+        server::observation const &stepped = ring[3 * reply.depth + 3 % reply.depth];
+        CHECK(stepped.sequence == 3);
+        CHECK(stepped.frames == 3);
+        CHECK(stepped.cycles == 3 * mpu::chip8::default_frame_instructions);
+        CHECK(stepped.keys == 0);
+        CHECK(stepped.watch[0] == 0x60);
+
+        server::observation const &reset = ring[1 * reply.depth + 3 % reply.depth];
+        CHECK(reset.sequence == 3);
+        CHECK(reset.frames == 0);
+        CHECK(reset.pc == mpu::chip8::program_start);
+        munmap(mapping, reply.segment_size);
+    }
+
+    ::close(segment);
+    ::close(client);
+    host.stop();
+    serving.join();
+    host.close();
+    unlink(romPath.c_str());
+
+    if (s_failures)
+    {
+        printf("chip8_server_test: %d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("chip8_server_test passed\n");
+    return 0;
+}
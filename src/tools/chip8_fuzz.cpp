@@ -0,0 +1,440 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// chip8_fuzz: differential fuzzer for the execution engines
+//
+// generates random and mutated programs, runs each on the reference
+// interpreter (chip8::clock) and every alternative engine in lock-step and
+// reports the first cycle where their state diverges.
+//
+//   chip8_fuzz [-threads N] [-runs N] [-seconds N] [-cycles N] [-seed N]
+//
+// built with CHIP8_LIBFUZZER the same checks run from LLVMFuzzerTestOneInput.
+
+#include "chip8.h"
+#include "rom.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const uint32_t max_program_size = 512; // bytes
+    const uint32_t chunk_size       = 64;  // instructions between state compares
+
+    struct engine
+    {
+        char const *name;
+        void (*step)(mpu::chip8 &cpu, uint32_t count);
+    };
+
+    void step_reference(mpu::chip8 &cpu, uint32_t count)
+    {
+        while (count--)
+        {
+            cpu.clock();
+        }
+    }
+
+    void step_decoded(mpu::chip8 &cpu, uint32_t count)
+    {
+        cpu.run(count);
+    }
+
+    // s_engines[0] is the reference every other engine is compared against
+    engine const s_engines[] =
+    {
+        { "reference", step_reference },
+        { "decoded",   step_decoded },
+    };
+    uint32_t const s_engineCount = sizeof(s_engines) / sizeof(*s_engines);
+
+    struct program
+    {
+        uint32_t seed; // also picks the held keys
+        uint32_t cycles;
+        std::vector<uint8_t> bytes;
+    };
+
+    bool same_state(mpu::chip8 const &a, mpu::chip8 const &b)
+    {
+        if (a.get_pc() != b.get_pc() || a.get_i() != b.get_i() || a.get_sp() != b.get_sp() ||
+            a.get_cycles() != b.get_cycles() || a.get_faults() != b.get_faults() ||
+            a.get_delay() != b.get_delay() || a.get_sound() != b.get_sound() ||
+            a.get_audio().pitch != b.get_audio().pitch ||
+            memcmp(a.get_audio().pattern, b.get_audio().pattern, sizeof(a.get_audio().pattern)) != 0)
+        {
+            return false;
+        }
+        for (uint32_t r = 0; r < mpu::chip8::num; ++r)
+        {
+            if (a.get_register(static_cast<mpu::chip8::reg>(r)) != b.get_register(static_cast<mpu::chip8::reg>(r)))
+            {
+                return false;
+            }
+        }
+        for (uint32_t level = 0; level < mpu::chip8::stack_depth; ++level)
+        {
+            if (a.get_stack(level) != b.get_stack(level))
+            {
+                return false;
+            }
+        }
+        return memcmp(a.memory(), b.memory(), mpu::chip8::memory_size) == 0 &&
+               memcmp(&a.display(), &b.display(), sizeof(mpu::framebuffer)) == 0;
+    }
+
+    void print_state(char const *name, mpu::chip8 const &cpu)
+    {
+        printf("  %-10s pc=%03X I=%03X sp=%X DT=%02X ST=%02X keys=%04X faults=%u cycles=%llu\n  %-10s",
+               name, cpu.get_pc(), cpu.get_i(), cpu.get_sp(), cpu.get_delay(), cpu.get_sound(),
+               cpu.get_keys(), cpu.get_faults(), static_cast<unsigned long long>(cpu.get_cycles()), "");
+        for (uint32_t r = 0; r < mpu::chip8::num; ++r)
+        {
+            printf(" V%X=%02X", r, cpu.get_register(static_cast<mpu::chip8::reg>(r)));
+        }
+        printf("\n  %-10s stack:", "");
+        for (uint32_t level = 0; level < mpu::chip8::stack_depth; ++level)
+        {
+            printf(" %03X", cpu.get_stack(level));
+        }
+        printf("\n");
+    }
+
+    // the reference loads byte by byte, candidates boot from a pre-decoded
+    // rom::image so the shared decode path is checked as well
+    void prepare(mpu::chip8 &cpu, program const &prog, bool reference)
+    {
+        cpu.seed(prog.seed);
+        if (reference)
+        {
+            cpu.init();
+            cpu.load(mpu::chip8::program_start, prog.bytes.data(), prog.bytes.size());
+        }
+        else
+        {
+            rom::image(prog.bytes.data(), prog.bytes.size(), 0).boot(cpu);
+        }
+        cpu.set_keys((prog.seed & 1) ? prog.seed >> 16 : 0);
+    }
+
+    // returns the first diverging cycle, or UINT64_MAX if the engine matches
+    uint64_t find_divergence(engine const &alt, program const &prog)
+    {
+        mpu::hardware_hooks hooks;
+        mpu::chip8 reference(hooks);
+        mpu::chip8 candidate(hooks);
+        prepare(reference, prog, true);
+        prepare(candidate, prog, false);
+
+        for (uint32_t done = 0; done < prog.cycles; done += chunk_size)
+        {
+            uint32_t count = prog.cycles - done < chunk_size ? prog.cycles - done : chunk_size;
+            s_engines[0].step(reference, count);
+            alt.step(candidate, count);
+
+            if (same_state(reference, candidate) == false)
+            {
+                // replay the chunk one instruction at a time to find the exact cycle
+                prepare(reference, prog, true);
+                prepare(candidate, prog, false);
+                s_engines[0].step(reference, done);
+                alt.step(candidate, done);
+                for (uint32_t n = 0; n < count; ++n)
+                {
+                    s_engines[0].step(reference, 1);
+                    alt.step(candidate, 1);
+                    if (same_state(reference, candidate) == false)
+                    {
+                        return done + n;
+                    }
+                }
+                return done;
+            }
+        }
+        return UINT64_MAX;
+    }
+
+    void report(engine const &alt, program const &prog, uint64_t cycle)
+    {
+        mpu::hardware_hooks hooks;
+        mpu::chip8 reference(hooks);
+        mpu::chip8 candidate(hooks);
+        prepare(reference, prog, true);
+        prepare(candidate, prog, false);
+        s_engines[0].step(reference, cycle);
+        alt.step(candidate, cycle);
+
+        uint16_t const pc = reference.get_pc() & mpu::chip8::address_mask;
+        uint8_t const *mem = reference.memory();
+        printf("engine \"%s\" diverges from \"%s\" at cycle %llu executing %04X at pc=%03X\n",
+               alt.name, s_engines[0].name, static_cast<unsigned long long>(cycle),
+               (mem[pc] << 8u) | mem[(pc + 1) & mpu::chip8::address_mask], pc);
+        printf("before:\n");
+        print_state(s_engines[0].name, reference);
+        print_state(alt.name, candidate);
+
+        s_engines[0].step(reference, 1);
+        alt.step(candidate, 1);
+        printf("after:\n");
+        print_state(s_engines[0].name, reference);
+        print_state(alt.name, candidate);
+
+        // keep a reproducer, the seed is the first 4 bytes like the libFuzzer input
+        char path[64];
+        snprintf(path, sizeof(path), "diverge-%s-%08X.bin", alt.name, prog.seed);
+        FILE *file = fopen(path, "wb");
+        if (file)
+        {
+            fwrite(&prog.seed, sizeof(prog.seed), 1, file);
+            fwrite(prog.bytes.data(), 1, prog.bytes.size(), file);
+            fclose(file);
+            printf("reproducer written to %s\n", path);
+        }
+    }
+
+    bool check_program(program const &prog, std::mutex &reportMutex)
+    {
+        for (uint32_t e = 1; e < s_engineCount; ++e)
+        {
+            uint64_t cycle = find_divergence(s_engines[e], prog);
+            if (cycle != UINT64_MAX)
+            {
+                std::lock_guard<std::mutex> lock(reportMutex);
+                report(s_engines[e], prog, cycle);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // per-thread generator, xorshift so runs are reproducible from -seed
+    class generator
+    {
+        public:
+            explicit generator(uint32_t seed) : state(seed ? seed : 1) {}
+
+            uint32_t next(void)
+            {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                return state;
+            }
+
+            uint32_t below(uint32_t bound) { return next() % bound; }
+
+            // mostly well formed instructions so execution gets past the first opcode
+            uint16_t instruction(void)
+            {
+                static uint16_t const s_fSuffix[] = { 0x02, 0x07, 0x0A, 0x15, 0x18, 0x1E, 0x29, 0x33, 0x3A, 0x55, 0x65 };
+                static uint16_t const s_8Suffix[] = { 0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE };
+
+                uint16_t op = next() & 0xFFFF;
+                if (below(8) == 0)
+                {
+                    return op; // fully random
+                }
+
+                switch (op & 0xF000)
+                {
+                    case 0x0000: return below(2) ? 0x00E0 : 0x00EE;
+                    case 0x1000:
+                    case 0x2000:
+                    case 0xA000:
+                    case 0xB000: return (op & 0xF000) | (0x200 + below(max_program_size)); // stay near the program
+                    case 0x5000:
+                    case 0x9000: return op & 0xFFF0;
+                    case 0x8000: return (op & 0xFFF0) | s_8Suffix[below(sizeof(s_8Suffix) / sizeof(*s_8Suffix))];
+                    case 0xE000: return (op & 0xFF00) | (below(2) ? 0x9E : 0xA1);
+                    case 0xF000: return (op & 0xFF00) | s_fSuffix[below(sizeof(s_fSuffix) / sizeof(*s_fSuffix))];
+                }
+                return op;
+            }
+
+            void fresh(program &prog)
+            {
+                prog.seed = next();
+                prog.cycles = 1 + below(20000);
+                prog.bytes.resize(2 * (1 + below(max_program_size / 2)));
+                for (size_t n = 0; n + 1 < prog.bytes.size(); n += 2)
+                {
+                    uint16_t op = instruction();
+                    prog.bytes[n] = op >> 8u;
+                    prog.bytes[n + 1] = op & 0xFF;
+                }
+            }
+
+            void mutate(program &prog)
+            {
+                uint32_t edits = 1 + below(4);
+                while (edits--)
+                {
+                    size_t at = below(prog.bytes.size()) & ~1u;
+                    switch (below(3))
+                    {
+                        case 0: // flip a bit anywhere
+                            prog.bytes[below(prog.bytes.size())] ^= 1u << below(8);
+                            break;
+                        case 1: // replace an instruction
+                        {
+                            uint16_t op = instruction();
+                            prog.bytes[at] = op >> 8u;
+                            prog.bytes[at + 1] = op & 0xFF;
+                        } break;
+                        case 2: // duplicate an instruction over its neighbour
+                            if (at + 3 < prog.bytes.size())
+                            {
+                                prog.bytes[at + 2] = prog.bytes[at];
+                                prog.bytes[at + 3] = prog.bytes[at + 1];
+                            }
+                            break;
+                    }
+                }
+                prog.seed = next();
+            }
+
+        private:
+            uint32_t state;
+    };
+}
+
+#ifdef CHIP8_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const *data, size_t size)
+{
+    static std::mutex s_reportMutex;
+
+    if (size < sizeof(uint32_t))
+    {
+        return 0;
+    }
+
+    program prog;
+    memcpy(&prog.seed, data, sizeof(prog.seed));
+    prog.cycles = 4096;
+    prog.bytes.assign(data + sizeof(uint32_t), data + (size < max_program_size ? size : max_program_size));
+
+    if (check_program(prog, s_reportMutex) == false)
+    {
+        abort();
+    }
+    return 0;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+    uint32_t threads = std::thread::hardware_concurrency();
+    uint64_t runs    = 0; // 0 = until -seconds or a divergence
+    uint32_t seconds = 60;
+    uint32_t cycles  = 0; // 0 = random per program
+    uint32_t seed    = static_cast<uint32_t>(time(nullptr));
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string opt(argv[i]);
+        if (opt == "-threads" && i + 1 < argc)
+            threads = strtoul(argv[++i], nullptr, 0);
+        else if (opt == "-runs" && i + 1 < argc)
+            runs = strtoull(argv[++i], nullptr, 0);
+        else if (opt == "-seconds" && i + 1 < argc)
+            seconds = strtoul(argv[++i], nullptr, 0);
+        else if (opt == "-cycles" && i + 1 < argc)
+            cycles = strtoul(argv[++i], nullptr, 0);
+        else if (opt == "-seed" && i + 1 < argc)
+            seed = strtoul(argv[++i], nullptr, 0);
+        else
+        {
+            printf("usage: chip8_fuzz [-threads N] [-runs N] [-seconds N] [-cycles N] [-seed N]\n");
+            return 1;
+        }
+    }
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+
+    printf("chip8_fuzz: %u threads, seed %u, %u engines\n", threads, seed, s_engineCount);
+
+    std::atomic<uint64_t> executed(0);
+    std::atomic<bool>     failed(false);
+    std::mutex            reportMutex;
+    auto const            start = std::chrono::steady_clock::now();
+    auto const            deadline = start + std::chrono::seconds(seconds);
+
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]() {
+            generator gen(seed + 0x9E3779B9u * (t + 1));
+            program   prog;
+            gen.fresh(prog);
+
+            while (failed == false)
+            {
+                uint64_t n = executed.fetch_add(1);
+                if ((runs && n >= runs) ||
+                    (runs == 0 && (n & 0xFF) == 0 && std::chrono::steady_clock::now() >= deadline))
+                {
+                    break;
+                }
+
+                // half fresh programs, half mutations of the previous one
+                if (gen.below(2))
+                    gen.fresh(prog);
+                else
+                    gen.mutate(prog);
+                if (cycles)
+                    prog.cycles = cycles;
+
+                if (check_program(prog, reportMutex) == false)
+                {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t total = runs && executed > runs ? runs : executed.load();
+    printf("%llu programs in %.1fs (%.0f programs/s)%s\n",
+           static_cast<unsigned long long>(total), elapsed, total / elapsed,
+           failed ? ", DIVERGENCE FOUND" : ", all engines match");
+
+    return failed ? 2 : 0;
+}
+
+#endif
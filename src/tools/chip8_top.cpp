@@ -0,0 +1,296 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// chip8_top: live view of every chip8 process publishing telemetry
+//
+//   chip8_top [-interval MS] [-once] [-pid N] [-all] [-clean]
+
+#include "telemetry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+
+namespace
+{
+    struct options
+    {
+        uint32_t interval = 1000; // ms
+        bool     once     = false;
+        uint32_t pid      = 0;    // 0 = every process
+        bool     all      = false;
+        bool     clean    = false;
+    };
+
+    // plain copy of a slot, taken once per refresh
+    struct sample
+    {
+        uint32_t state;
+        uint32_t status;
+        uint64_t instructions;
+        uint64_t frames;
+        uint64_t presented;
+        uint64_t faults;
+        uint64_t start;
+        uint64_t updated;
+        uint64_t update_ns[debug::telemetry_slot::buckets];
+        std::string name;
+    };
+
+    struct process
+    {
+        debug::telemetry_reader reader;
+        std::vector<sample>     last;
+        uint64_t                lastTime = 0;
+    };
+
+    void usage(void)
+    {
+        printf("usage: chip8_top [-interval MS] [-once] [-pid N] [-all] [-clean]\n");
+    }
+
+    sample read_slot(debug::telemetry_slot const &slot)
+    {
+        sample s;
+        s.state        = slot.slot_state.load(std::memory_order_acquire);
+        s.status       = slot.status.load(std::memory_order_relaxed);
+        s.instructions = slot.instructions.load(std::memory_order_relaxed);
+        s.frames       = slot.frames.load(std::memory_order_relaxed);
+        s.presented    = slot.presented.load(std::memory_order_relaxed);
+        s.faults       = slot.faults.load(std::memory_order_relaxed);
+        s.start        = slot.start_ns.load(std::memory_order_relaxed);
+        s.updated      = slot.updated_ns.load(std::memory_order_relaxed);
+        for (uint32_t b = 0; b < debug::telemetry_slot::buckets; ++b)
+        {
+            s.update_ns[b] = slot.update_ns[b].load(std::memory_order_relaxed);
+        }
+        s.name.assign(slot.name, strnlen(slot.name, sizeof(slot.name)));
+        return s;
+    }
+
+    // upper bound of the histogram bucket holding the given percentile, in microseconds
+    double percentile(uint64_t const *counts, double fraction)
+    {
+        uint64_t total = 0;
+        for (uint32_t b = 0; b < debug::telemetry_slot::buckets; ++b)
+        {
+            total += counts[b];
+        }
+        if (total == 0)
+        {
+            return 0.0;
+        }
+
+        uint64_t const rank = static_cast<uint64_t>(fraction * (total - 1)) + 1;
+        uint64_t seen = 0;
+        for (uint32_t b = 0; b < debug::telemetry_slot::buckets; ++b)
+        {
+            seen += counts[b];
+            if (seen >= rank)
+            {
+                return static_cast<double>(2ull << b) / 1000.0;
+            }
+        }
+        return 0.0;
+    }
+
+    void refresh(std::map<std::string, std::unique_ptr<process>> &processes,
+                 std::vector<std::string> const &names, options const &opt)
+    {
+        // pick up new processes, forget the ones that went away
+        for (auto const &name : names)
+        {
+            if (processes.count(name) == 0)
+            {
+                std::unique_ptr<process> p(new process());
+                if (p->reader.open(name) && (opt.pid == 0 || p->reader.info().pid == opt.pid))
+                {
+                    processes[name] = std::move(p);
+                }
+            }
+        }
+        for (auto it = processes.begin(); it != processes.end();)
+        {
+            bool const listed = std::find(names.begin(), names.end(), it->first) != names.end();
+            it = listed ? std::next(it) : processes.erase(it);
+        }
+    }
+
+    void print(std::map<std::string, std::unique_ptr<process>> &processes,
+               std::vector<std::string> const &names, options const &opt)
+    {
+        static char const *const s_status[] = { "idle", "run", "pass", "FAIL", "ERR", "new" };
+
+        printf("%7s %4s %-24s %-5s %9s %10s %9s %8s %9s %9s %7s %14s\n",
+               "PID", "SLOT", "NAME", "STAT", "MIPS", "EMU FPS", "SPEED", "UI FPS",
+               "UPD p50", "UPD p99", "FAULTS", "INSTRUCTIONS");
+
+        double   totalMips = 0.0;
+        uint32_t counts[debug::telemetry_slot::num_status] = {};
+        uint32_t instances = 0;
+
+        for (auto &entry : processes)
+        {
+            process &p = *entry.second;
+            uint32_t const pid = p.reader.info().pid;
+
+            // a process that exited cleanly has already unlinked its segment,
+            // one that is still listed died without doing so
+            bool const exited = p.reader.alive() == false;
+            if (exited && std::find(names.begin(), names.end(), entry.first) != names.end())
+            {
+                printf("%7u      %-24s stale\n", pid, entry.first.c_str());
+                if (opt.clean)
+                {
+                    shm_unlink(entry.first.c_str());
+                }
+                continue;
+            }
+
+            uint64_t const now = debug::telemetry::now();
+            std::vector<sample> current(p.reader.size());
+            for (uint32_t n = 0; n < p.reader.size(); ++n)
+            {
+                current[n] = read_slot(p.reader[n]);
+            }
+
+            for (uint32_t n = 0; n < current.size(); ++n)
+            {
+                sample const &s = current[n];
+                if (s.state == debug::telemetry_slot::unused)
+                {
+                    continue;
+                }
+                ++instances;
+                counts[s.status < debug::telemetry_slot::num_status ? s.status : 0]++;
+                if (s.state == debug::telemetry_slot::finished && opt.all == false)
+                {
+                    continue;
+                }
+
+                // rates over the last refresh while the same instance was running,
+                // otherwise over its whole lifetime
+                bool const delta = p.lastTime && n < p.last.size() &&
+                                   p.last[n].start == s.start && p.last[n].state == debug::telemetry_slot::active;
+                sample const *before = delta ? &p.last[n] : nullptr;
+                uint64_t const end     = (s.state == debug::telemetry_slot::active && exited == false) ? now : s.updated;
+                uint64_t const begin   = delta ? p.lastTime : s.start;
+                double   const seconds = end > begin ? (end - begin) / 1e9 : 0.0;
+
+                uint64_t const instructions = s.instructions - (before ? before->instructions : 0);
+                uint64_t const frames       = s.frames       - (before ? before->frames : 0);
+                uint64_t const presented    = s.presented    - (before ? before->presented : 0);
+                uint64_t updates[debug::telemetry_slot::buckets];
+                for (uint32_t b = 0; b < debug::telemetry_slot::buckets; ++b)
+                {
+                    updates[b] = s.update_ns[b] - (before ? before->update_ns[b] : 0);
+                }
+
+                double const mips = seconds > 0.0 ? instructions / seconds / 1e6 : 0.0;
+                double const fps  = seconds > 0.0 ? frames / seconds : 0.0;
+                double const ui   = seconds > 0.0 ? presented / seconds : 0.0;
+                if (s.state == debug::telemetry_slot::active)
+                {
+                    totalMips += mips;
+                }
+
+                printf("%7u %4u %-24.24s %-5s %9.2f %10.1f %8.2fx %8.1f %7.1fus %7.1fus %7llu %14llu\n",
+                       pid, n, s.name.c_str(), s_status[s.status < debug::telemetry_slot::num_status ? s.status : 0],
+                       mips, fps, fps / 60.0, ui,
+                       percentile(updates, 0.50), percentile(updates, 0.99),
+                       static_cast<unsigned long long>(s.faults),
+                       static_cast<unsigned long long>(s.instructions));
+            }
+
+            p.last.swap(current);
+            p.lastTime = now;
+        }
+
+        printf("%u processes, %u instances (%u running, %u passed, %u failed, %u errors), %.2f MIPS total\n",
+               static_cast<uint32_t>(processes.size()), instances,
+               counts[debug::telemetry_slot::running], counts[debug::telemetry_slot::passed],
+               counts[debug::telemetry_slot::failed], counts[debug::telemetry_slot::error], totalMips);
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    options opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg == "-interval" && i + 1 < argc)
+            opt.interval = strtoul(argv[++i], nullptr, 0);
+        else if (arg == "-once")
+            opt.once = true;
+        else if (arg == "-pid" && i + 1 < argc)
+            opt.pid = strtoul(argv[++i], nullptr, 0);
+        else if (arg == "-all")
+            opt.all = true;
+        else if (arg == "-clean")
+            opt.clean = true;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    std::map<std::string, std::unique_ptr<process>> processes;
+    if (opt.once)
+    {
+        // two samples so the rates cover one interval
+        refresh(processes, debug::telemetry_reader::list(), opt);
+        for (auto &entry : processes)
+        {
+            process &p = *entry.second;
+            p.last.resize(p.reader.size());
+            for (uint32_t n = 0; n < p.reader.size(); ++n)
+            {
+                p.last[n] = read_slot(p.reader[n]);
+            }
+            p.lastTime = debug::telemetry::now();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(opt.interval));
+        print(processes, debug::telemetry_reader::list(), opt);
+        return 0;
+    }
+
+    for (;;)
+    {
+        std::vector<std::string> const names = debug::telemetry_reader::list();
+        refresh(processes, names, opt);
+        printf("\033[H\033[2J");
+        print(processes, names, opt);
+        std::this_thread::sleep_for(std::chrono::milliseconds(opt.interval));
+    }
+}
@@ -0,0 +1,226 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// chip8_trace: offline decoder for instruction logs written by chip8 -trace
+//
+//   chip8_trace dump <log> [-from N] [-to N] [-pc ADDR] [-op MASK VALUE] [-faults]
+//   chip8_trace diff <log a> <log b> [-context N]
+
+#include "debugger.h"
+#include "instruction_log.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static void usage(void)
+{
+    printf("usage: chip8_trace dump <log> [-from N] [-to N] [-pc ADDR] [-op MASK VALUE] [-faults]\n"
+           "       chip8_trace diff <log a> <log b> [-context N]\n");
+}
+
+static void print_record(char const *prefix, debug::instruction_record const& r)
+{
+    printf("%s%10llu  pc=%03X op=%04X %-16s I=%03X sp=%X VF=%02X",
+           prefix,
+           static_cast<unsigned long long>(r.cycle),
+           r.pc, r.op, debug::debugger::disassemble(r.op).c_str(), r.i, r.sp, r.vf);
+
+    if (r.reg != debug::instruction_record::no_register)
+    {
+        printf(" V%X=%02X", r.reg, r.reg_value);
+    }
+    if (r.mem_len)
+    {
+        printf(" mem[%03X..+%u]=%02X", r.mem_addr, r.mem_len, r.mem_value);
+    }
+    if (r.flags & debug::instruction_record::hardfault)
+    {
+        printf(" HARDFAULT");
+    }
+    printf("\n");
+}
+
+static bool same_record(debug::instruction_record const& a, debug::instruction_record const& b)
+{
+    return a.cycle == b.cycle && a.pc == b.pc && a.op == b.op && a.i == b.i &&
+           a.mem_addr == b.mem_addr && a.mem_len == b.mem_len && a.mem_value == b.mem_value &&
+           a.reg == b.reg && a.reg_value == b.reg_value && a.vf == b.vf &&
+           a.sp == b.sp && a.flags == b.flags;
+}
+
+static bool open_log(debug::instruction_log_reader &log, char const *path)
+{
+    if (log.open(path) == false)
+    {
+        printf("chip8_trace: cannot read instruction log \"%s\"\n", path);
+        return false;
+    }
+    return true;
+}
+
+static int dump(int argc, char **argv)
+{
+    if (argc < 1)
+    {
+        usage();
+        return 1;
+    }
+
+    uint64_t from = 0;
+    uint64_t to = UINT64_MAX;
+    int32_t  pc = -1;
+    uint16_t opMask = 0;
+    uint16_t opValue = 0;
+    bool     faultsOnly = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string opt(argv[i]);
+        if (opt == "-from" && i + 1 < argc)
+            from = strtoull(argv[++i], nullptr, 0);
+        else if (opt == "-to" && i + 1 < argc)
+            to = strtoull(argv[++i], nullptr, 0);
+        else if (opt == "-pc" && i + 1 < argc)
+            pc = strtol(argv[++i], nullptr, 16);
+        else if (opt == "-op" && i + 2 < argc)
+        {
+            opMask = strtol(argv[++i], nullptr, 16);
+            opValue = strtol(argv[++i], nullptr, 16);
+        }
+        else if (opt == "-faults")
+            faultsOnly = true;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    debug::instruction_log_reader log;
+    if (open_log(log, argv[0]) == false)
+    {
+        return 1;
+    }
+
+    uint64_t shown = 0;
+    for (uint64_t n = 0; n < log.size(); ++n)
+    {
+        debug::instruction_record const& r = log[n];
+        if (r.cycle < from || r.cycle > to) continue;
+        if (pc >= 0 && r.pc != pc) continue;
+        if ((r.op & opMask) != opValue) continue;
+        if (faultsOnly && (r.flags & debug::instruction_record::hardfault) == 0) continue;
+
+        print_record("", r);
+        ++shown;
+    }
+
+    printf("%llu of %llu records\n",
+           static_cast<unsigned long long>(shown),
+           static_cast<unsigned long long>(log.size()));
+    return 0;
+}
+
+static int diff(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        usage();
+        return 1;
+    }
+
+    uint64_t context = 8;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string opt(argv[i]);
+        if (opt == "-context" && i + 1 < argc)
+            context = strtoull(argv[++i], nullptr, 0);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    debug::instruction_log_reader a, b;
+    if (open_log(a, argv[0]) == false || open_log(b, argv[1]) == false)
+    {
+        return 1;
+    }
+
+    uint64_t const common = a.size() < b.size() ? a.size() : b.size();
+    uint64_t n = 0;
+    while (n < common && same_record(a[n], b[n]))
+    {
+        ++n;
+    }
+
+    if (n == common && a.size() == b.size())
+    {
+        printf("identical, %llu records\n", static_cast<unsigned long long>(n));
+        return 0;
+    }
+
+    for (uint64_t k = (n > context ? n - context : 0); k < n; ++k)
+    {
+        print_record("  ", a[k]);
+    }
+
+    if (n == common)
+    {
+        printf("traces diverge at record %llu: %s ends first (%llu vs %llu records)\n",
+               static_cast<unsigned long long>(n),
+               a.size() < b.size() ? argv[0] : argv[1],
+               static_cast<unsigned long long>(a.size()),
+               static_cast<unsigned long long>(b.size()));
+    }
+    else
+    {
+        printf("traces diverge at record %llu:\n", static_cast<unsigned long long>(n));
+        print_record("a ", a[n]);
+        print_record("b ", b[n]);
+    }
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        usage();
+        return 1;
+    }
+
+    std::string command(argv[1]);
+    if (command == "dump")
+    {
+        return dump(argc - 2, &argv[2]);
+    }
+    else if (command == "diff")
+    {
+        return diff(argc - 2, &argv[2]);
+    }
+
+    usage();
+    return 1;
+}
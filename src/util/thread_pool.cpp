@@ -0,0 +1,140 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "thread_pool.h"
+
+util::thread_pool::thread_pool(uint32_t threads) :
+    job(nullptr),
+    jobCount(0),
+    generation(0),
+    busy(0),
+    stop(false),
+    next(0)
+{
+    if (threads == 0)
+    {
+        threads = std::thread::hardware_concurrency();
+    }
+
+    try
+    {
+        workers.reserve(threads > 1 ? threads - 1 : 0);
+        for (uint32_t t = 1; t < threads; ++t)
+        {
+            workers.emplace_back(&thread_pool::work, this);
+        }
+    }
+    catch (...)
+    {
+        // the destructor will not run, joinable threads would terminate
+        shutdown();
+        throw;
+    }
+}
+
+util::thread_pool::~thread_pool()
+{
+    shutdown();
+}
+
+void util::thread_pool::shutdown(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stop = true;
+    }
+    wake.notify_all();
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void util::thread_pool::parallel_for(uint32_t count, std::function<void(uint32_t)> const& body)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> jobLock(jobMutex);
+
+    if (workers.empty() || count == 1)
+    {
+        for (uint32_t index = 0; index < count; ++index)
+        {
+            body(index);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        job      = &body;
+        jobCount = count;
+        next     = 0;
+        busy     = workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    // the calling thread takes a share of the work too
+    drain();
+
+    std::unique_lock<std::mutex> lock(stateMutex);
+    finished.wait(lock, [this]() { return busy == 0; });
+    job = nullptr;
+}
+
+void util::thread_pool::drain(void)
+{
+    for (uint32_t index = next.fetch_add(1); index < jobCount; index = next.fetch_add(1))
+    {
+        (*job)(index);
+    }
+}
+
+void util::thread_pool::work(void)
+{
+    uint64_t seen = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            wake.wait(lock, [&]() { return stop || generation != seen; });
+            if (stop)
+            {
+                return;
+            }
+            seen = generation;
+        }
+
+        drain();
+
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (--busy == 0)
+        {
+            finished.notify_one();
+        }
+    }
+}
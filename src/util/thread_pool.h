@@ -0,0 +1,67 @@
+// MIT License
+// 
+// Copyright (c) 2020 Jimi Huard
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util
+{
+    // fixed set of worker threads running one indexed job at a time
+    class thread_pool
+    {
+        public:
+            // threads == 0 uses one thread per core, the caller counts as one
+            explicit thread_pool(uint32_t threads = 0);
+            ~thread_pool();
+
+            uint32_t size(void) const { return workers.size() + 1; }
+
+            // runs body(0..count-1) across the pool, returns when all are done
+            void parallel_for(uint32_t count, std::function<void(uint32_t)> const& body);
+
+        private:
+            std::vector<std::thread>               workers;
+            std::mutex                             jobMutex;   // one parallel_for at a time
+            std::mutex                             stateMutex;
+            std::condition_variable                wake;
+            std::condition_variable                finished;
+            std::function<void(uint32_t)> const   *job;
+            uint32_t                               jobCount;
+            uint64_t                               generation;
+            uint32_t                               busy;
+            bool                                   stop;
+            std::atomic<uint32_t>                  next;
+
+            void work(void);
+            void drain(void);
+            void shutdown(void);
+    };
+}
+
+#endif//__THREAD_POOL_H__